@@ -0,0 +1,143 @@
+#include "CongestionControl.h"
+#include "Util.h"
+
+#include <cassert>
+
+
+namespace Zerodelay
+{
+	ICongestionControl* ICongestionControl::create(ECongestionControl type, u32_t maxSegmentSize)
+	{
+		switch ( type )
+		{
+		case ECongestionControl::NewReno:
+			return new NewRenoCongestion( maxSegmentSize );
+		case ECongestionControl::DelayBased:
+			return new DelayBasedCongestion( maxSegmentSize );
+		default:
+			break;
+		}
+		return nullptr;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// NewReno
+	//////////////////////////////////////////////////////////////////////////
+
+	NewRenoCongestion::NewRenoCongestion(u32_t maxSegmentSize):
+		m_MaxSegmentSize(maxSegmentSize),
+		m_Window(10*maxSegmentSize), // initial window (RFC 6928)
+		m_SlowStartThreshold(~0U),
+		m_BytesAckedInAvoidance(0),
+		m_RecoveryEndTS(0)
+	{
+	}
+
+	void NewRenoCongestion::onAck(u32_t numBytes, i32_t /*rttSample*/, u32_t /*smoothedRtt*/, i32_t /*timeNow*/)
+	{
+		if ( m_Window < m_SlowStartThreshold )
+		{
+			// slow start, window doubles every round trip
+			m_Window += Util::min( numBytes, m_MaxSegmentSize );
+			return;
+		}
+		// congestion avoidance, window grows one segment every round trip
+		m_BytesAckedInAvoidance += numBytes;
+		if ( m_BytesAckedInAvoidance >= m_Window )
+		{
+			m_BytesAckedInAvoidance -= m_Window;
+			m_Window += m_MaxSegmentSize;
+		}
+	}
+
+	void NewRenoCongestion::onLoss(u32_t smoothedRtt, i32_t timeNow, bool bTimeout)
+	{
+		// all packets that were in flight at time of the loss will time out as well, do not punish again for those
+		if ( (timeNow - m_RecoveryEndTS) < 0 )
+			return;
+		m_RecoveryEndTS = timeNow + (i32_t)Util::max( smoothedRtt, 1U );
+		m_SlowStartThreshold = Util::max( m_Window/2, 2*m_MaxSegmentSize );
+		m_Window = bTimeout ? m_MaxSegmentSize : m_SlowStartThreshold;
+		m_BytesAckedInAvoidance = 0;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Delay based
+	//////////////////////////////////////////////////////////////////////////
+
+	DelayBasedCongestion::DelayBasedCongestion(u32_t maxSegmentSize):
+		NewRenoCongestion(maxSegmentSize),
+		m_BaseRtt(-1),
+		m_BaseRttTS(0)
+	{
+	}
+
+	void DelayBasedCongestion::onAck(u32_t numBytes, i32_t rttSample, u32_t smoothedRtt, i32_t timeNow)
+	{
+		if ( rttSample < 0 )
+		{
+			// no delay information, only allow the window to recover to the slow start threshold
+			if ( m_Window < m_SlowStartThreshold )
+				NewRenoCongestion::onAck( numBytes, rttSample, smoothedRtt, timeNow );
+			return;
+		}
+		if ( m_BaseRtt < 0 || rttSample <= m_BaseRtt || (timeNow - m_BaseRttTS) > sm_BaseRttHistoryMs )
+		{
+			m_BaseRtt   = rttSample;
+			m_BaseRttTS = timeNow;
+		}
+		// offTarget is 1 without queuing delay, 0 at target and negative above target
+		i32_t queuingDelay = rttSample - m_BaseRtt;
+		float offTarget = (float)(sm_TargetQueuingDelayMs - queuingDelay) / (float)sm_TargetQueuingDelayMs;
+		float delta = offTarget * (float)numBytes * (float)m_MaxSegmentSize / (float)m_Window;
+		i32_t window = (i32_t)m_Window + (i32_t)delta;
+		m_Window = (u32_t)Util::max( window, 2*(i32_t)m_MaxSegmentSize );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Pacer
+	//////////////////////////////////////////////////////////////////////////
+
+	Pacer::Pacer(u32_t maxSegmentSize):
+		m_MinCapacity(sm_BurstSegments*maxSegmentSize),
+		m_Capacity(m_MinCapacity),
+		m_Tokens((float)m_Capacity),
+		m_BytesPerMs(0),
+		m_LastRefillTS(Util::timeNow())
+	{
+	}
+
+	void Pacer::setRate(u32_t window, u32_t smoothedRtt)
+	{
+		// 25% headroom, otherwise the pacer instead of the window becomes the limit
+		m_BytesPerMs = 1.25f * (float)window / (float)Util::max( smoothedRtt, 1U );
+		m_Capacity   = Util::max( m_MinCapacity, (u32_t)(m_BytesPerMs * sm_TimerGranularityMs) );
+	}
+
+	bool Pacer::consume(u32_t numBytes, i32_t timeNow)
+	{
+		refill( timeNow );
+		// allow a single packet bigger than the bucket if the bucket is full
+		if ( m_Tokens < (float)Util::min( numBytes, m_Capacity ) )
+			return false;
+		m_Tokens -= (float)numBytes;
+		return true;
+	}
+
+	i32_t Pacer::getTimeUntilAvailable(u32_t numBytes, i32_t timeNow) const
+	{
+		float tokens = Util::min( (float)m_Capacity, m_Tokens + (float)(timeNow - m_LastRefillTS) * m_BytesPerMs );
+		float needed = (float)Util::min( numBytes, m_Capacity ) - tokens;
+		if ( needed <= 0 )
+			return 0;
+		if ( m_BytesPerMs <= 0 )
+			return 1;
+		return (i32_t)(needed / m_BytesPerMs) + 1;
+	}
+
+	void Pacer::refill(i32_t timeNow)
+	{
+		m_Tokens = Util::min( (float)m_Capacity, m_Tokens + (float)(timeNow - m_LastRefillTS) * m_BytesPerMs );
+		m_LastRefillTS = timeNow;
+	}
+}
\ No newline at end of file
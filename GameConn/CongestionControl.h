@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Zerodelay.h"
+
+
+namespace Zerodelay
+{
+	// All sizes are in bytes, all times in milliseconds.
+	class ICongestionControl
+	{
+	public:
+		static ICongestionControl* create( ECongestionControl type, u32_t maxSegmentSize );
+		virtual ~ICongestionControl() = default;
+
+		// Amount of reliable data that may be unacknowledged (in flight).
+		virtual u32_t getWindow() const = 0;
+		// A sent reliable packet got acked. RttSample is -1 if the packet was retransmitted (Karn).
+		virtual void onAck( u32_t numBytes, i32_t rttSample, u32_t smoothedRtt, i32_t timeNow ) = 0;
+		// A reliable packet is considered lost, either because its retransmission timer expired or later packets were acked.
+		virtual void onLoss( u32_t smoothedRtt, i32_t timeNow, bool bTimeout ) = 0;
+	};
+
+
+	// AIMD, slow start followed by congestion avoidance (RFC 5681). Loss halves the window, a timeout resets it to 1 segment.
+	class NewRenoCongestion: public ICongestionControl
+	{
+	public:
+		NewRenoCongestion(u32_t maxSegmentSize);
+
+		virtual u32_t getWindow() const override { return m_Window; }
+		virtual void onAck( u32_t numBytes, i32_t rttSample, u32_t smoothedRtt, i32_t timeNow ) override;
+		virtual void onLoss( u32_t smoothedRtt, i32_t timeNow, bool bTimeout ) override;
+
+	protected:
+		u32_t m_MaxSegmentSize;
+		u32_t m_Window;
+		u32_t m_SlowStartThreshold;
+		u32_t m_BytesAckedInAvoidance;
+		i32_t m_RecoveryEndTS;			// only reduce window once per round trip
+	};
+
+
+	// Grows the window while the measured queuing delay (rtt - lowest rtt) is below a target and shrinks it when above (LEDBAT style).
+	// Backs off before queues on the path fill up, so it keeps latency low, but it yields to loss based flows.
+	class DelayBasedCongestion: public NewRenoCongestion
+	{
+	public:
+		static const i32_t sm_TargetQueuingDelayMs = 25;
+		static const i32_t sm_BaseRttHistoryMs = 60000;	// forget lowest rtt after this time as route may have changed
+
+		DelayBasedCongestion(u32_t maxSegmentSize);
+
+		virtual void onAck( u32_t numBytes, i32_t rttSample, u32_t smoothedRtt, i32_t timeNow ) override;
+
+	private:
+		i32_t m_BaseRtt;
+		i32_t m_BaseRttTS;
+	};
+
+
+	// Token bucket that spreads packets over the round trip time instead of sending a whole window in one burst.
+	class Pacer
+	{
+	public:
+		static const u32_t sm_BurstSegments = 2;
+		static const u32_t sm_TimerGranularityMs = 2;	// send thread sleeps in whole ms, bucket must hold what accumulates in that time
+
+		Pacer(u32_t maxSegmentSize);
+
+		// Rate follows congestion window / smoothed rtt (with some headroom so the window can still grow).
+		void setRate( u32_t window, u32_t smoothedRtt );
+		bool consume( u32_t numBytes, i32_t timeNow );
+		i32_t getTimeUntilAvailable( u32_t numBytes, i32_t timeNow ) const;
+
+	private:
+		void refill( i32_t timeNow );
+
+		u32_t m_MinCapacity;
+		u32_t m_Capacity;
+		float m_Tokens;
+		float m_BytesPerMs;
+		i32_t m_LastRefillTS;
+	};
+}
\ No newline at end of file
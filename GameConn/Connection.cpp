@@ -7,19 +7,22 @@
 namespace Zerodelay
 {
 #define Check_State( state ) \
-	if ( m_State != EConnectionState::##state ) \
+	if ( m_State != EConnectionState::state ) \
 	{\
 		return; \
 	}
 
 #define Ensure_State( state ) \
-	if ( m_State != EConnectionState::##state ) \
+	if ( m_State != EConnectionState::state ) \
 	{\
 		Platform::log("WARNING state mismatch in %s, line %d, wanted state %s, but is %d\n", ZERODELAY_FUNCTION, ZERODELAY_LINE, #state, m_State); \
 		return; \
 	}
 
 
+	const i8_t* const Connection::sm_CompactHeaderMetaKey = "zerodelay.compact_header";
+
+
 	Connection::Connection(ConnectionNode* connectionNode, bool wasConnector, RUDPLink* link, i32_t timeoutSeconds, i32_t keepAliveIntervalSeconds):
 		m_ConnectionNode(connectionNode),
 		m_Link(link),
@@ -56,7 +59,7 @@ namespace Zerodelay
 		if (m_DisconnectCalled)
 			return;
 		m_DisconnectCalled = true;
-		m_DisconnectTS = ::clock();
+		m_DisconnectTS = Util::timeNow();
 		if ( m_State == EConnectionState::Connected )
 		{
 			if (sendMsg) sendSystemMessage( EDataPacketType::Disconnect );
@@ -94,7 +97,7 @@ namespace Zerodelay
 	{
 		assert( m_State == EConnectionState::Idle ); // just called after creation
 		m_State = EConnectionState::Connecting;
-		m_StartConnectingTS = ::clock();
+		m_StartConnectingTS = Util::timeNow();
 		i32_t dstSize = ZERODELAY_BUFF_SIZE;
 		i8_t dataBuffer[ZERODELAY_BUFF_SIZE]; // deliberately bigger than dstSize
 		bool bSucces = false;
@@ -107,22 +110,36 @@ namespace Zerodelay
 			ptr = Util::appendString2( ptr, dstSize, kvp.second.c_str(), bSucces );
 			if (!bSucces) return false;
 		}
+		if ( m_Link->canUseCompactHeader() )
+		{
+			ptr = Util::appendString2( ptr, dstSize, sm_CompactHeaderMetaKey, bSucces );
+			if (!bSucces) return false;
+			ptr = Util::appendString2( ptr, dstSize, "1", bSucces );
+			if (!bSucces) return false;
+		}
 		sendSystemMessage( EDataPacketType::ConnectRequest, dataBuffer, ZERODELAY_BUFF_SIZE-dstSize );
 		return true;
 	}
 
-	void Connection::sendConnectAccept()
+	void Connection::sendConnectAccept(bool compactHeader)
 	{
 		assert( m_State == EConnectionState::Idle ); // just called after creation
 		m_State = EConnectionState::Connected;
 		m_Link->setConnected(true);
-		sendSystemMessage( EDataPacketType::ConnectAccept);
+		u8_t flags = 0;
+		if ( compactHeader )
+		{
+			// connector can read it from now on, so accept already goes out compact
+			m_Link->setCompactHeader();
+			flags |= sm_AcceptCompactHeaderBit;
+		}
+		sendSystemMessage( EDataPacketType::ConnectAccept, (const i8_t*)&flags, 1 );
 	}
 
 	void Connection::sendKeepAliveRequest()
 	{
 		Check_State( Connected );
-		m_KeepAliveTS = ::clock();
+		m_KeepAliveTS = Util::timeNow();
 		sendSystemMessage( EDataPacketType::KeepAliveRequest );
 	}
 
@@ -132,11 +149,15 @@ namespace Zerodelay
 		sendSystemMessage( EDataPacketType::KeepAliveAnswer );
 	}
 
-	void Connection::onReceiveConnectAccept()
+	void Connection::onReceiveConnectAccept(const i8_t* payload, i32_t payloadLen)
 	{
 		Check_State( Connecting );
 		m_State = EConnectionState::Connected;
-		m_KeepAliveTS = ::clock();
+		if ( payloadLen >= 1 && (payload[0] & sm_AcceptCompactHeaderBit) )
+		{
+			m_Link->setCompactHeader();
+		}
+		m_KeepAliveTS = Util::timeNow();
 		m_ConnectionNode->doConnectResultCallbacks(getEndPoint(), EConnectResult::Succes);
 		Platform::log( "Connection accepted to %s (id %d).", getEndPoint().toIpAndPort().c_str(), m_Link->id() );
 	}
@@ -159,7 +180,7 @@ namespace Zerodelay
 		if ( m_IsWaitingForKeepAlive )
 		{
 			m_IsWaitingForKeepAlive = false;
-			m_KeepAliveTS = ::clock();
+			m_KeepAliveTS = Util::timeNow();
 			// printf("received keep alive answer...\n"); // dbg
 		}
 	}
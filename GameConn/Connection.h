@@ -27,6 +27,11 @@ namespace Zerodelay
 	class Connection
 	{
 	public:
+		// Compact header negotiation. The connector asks for it with a meta data key (acceptors that do not know it
+		// pass it on as meta data). The acceptor confirms it with a flag in the accept payload (ignored by older connectors).
+		static const i8_t* const sm_CompactHeaderMetaKey;
+		static const u8_t sm_AcceptCompactHeaderBit = 1;
+
 		Connection( class ConnectionNode* connectionNode, bool wasConnector, class RUDPLink* link, i32_t timeoutSeconds=8, i32_t keepAliveIntervalSeconds=8 );
 		~Connection();
 		void cleanLink();
@@ -37,11 +42,11 @@ namespace Zerodelay
 		void setInvalidConnectPacket();
 		// -- sends
 		bool sendConnectRequest(const std::string& pw, const std::map<std::string, std::string>& metaData);
-		void sendConnectAccept();
+		void sendConnectAccept(bool compactHeader);
 		void sendKeepAliveRequest();
 		void sendKeepAliveAnswer();
 		// -- receives
-		void onReceiveConnectAccept();
+		void onReceiveConnectAccept(const i8_t* payload, i32_t payloadLen);
 		void onReceiveDisconnect();
 		void onReceiveKeepAliveRequest();
 		void onReceiveKeepAliveAnswer();
@@ -67,10 +72,10 @@ namespace Zerodelay
 		i32_t m_ConnectTimeoutSeconMs;
 		i32_t m_KeepAliveIntervalMs;
 		// timestamps
-		clock_t m_StartConnectingTS;
-		clock_t m_KeepAliveTS;
-		clock_t m_DisconnectTS;
-		clock_t m_MarkDeleteTS;
+		i32_t m_StartConnectingTS;
+		i32_t m_KeepAliveTS;
+		i32_t m_DisconnectTS;
+		i32_t m_MarkDeleteTS;
 		// state
 		bool m_IsWaitingForKeepAlive;
 		EConnectionState m_State;
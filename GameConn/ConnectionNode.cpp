@@ -442,7 +442,7 @@ namespace Zerodelay
 				recvConnectPacket(payload, payloadLen, link);
 				break;
 			case EDataPacketType::ConnectAccept:
-				g->onReceiveConnectAccept();
+				g->onReceiveConnectAccept(payload, payloadLen);
 				break;
 			case EDataPacketType::Disconnect:
 				recvDisconnectPacket(payload, payloadLen, g);
@@ -522,9 +522,11 @@ namespace Zerodelay
 			m_CoreNode->setCriticalError( ECriticalError::SerializationError, ZERODELAY_FUNCTION_LINE );
 			return;
 		}
+		// not user meta data
+		bool bCompactHeader = metaData.erase( Connection::sm_CompactHeaderMetaKey ) != 0 && link.canUseCompactHeader();
 		// All fine..
 		Connection* g = new Connection( this, false, &link, 8, m_KeepAliveIntervalSeconds );
-		g->sendConnectAccept();
+		g->sendConnectAccept( bCompactHeader );
 		m_Connections.insert( std::make_pair(link.getEndPoint(), g) );
 		doNewIncomingConnectionCallbacks(true, link.getEndPoint(), metaData);
 		if (m_RelayConnectAndDisconnect) sendRemoteConnected( g, metaData );
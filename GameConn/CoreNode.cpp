@@ -77,8 +77,8 @@ namespace Zerodelay
 	{
 		if ( (pack.flags & RelayBit) && isListening() && !isP2P() ) // send through to others
 		{
-			// except self (TODO move this to reception thread for immediate relay)
-			m_RecvNode->send( pack.data[0], pack.data+1, pack.len-1, &etp, true, pack.type, pack.channel, false /* relay only once */ );
+			// except self, normally done by the receive thread already (which clears the relay bit)
+			m_RecvNode->send( pack.data[0], pack.data+1, pack.len-1, &etp, true, pack.type, pack.channel, false /* relay only once */, nullptr, pack.subStream );
 		}
 		ZEndpoint ztp = Util::toZpt(etp);
 		Util::forEachCallback(m_CustomDataCallbacks, [&](auto& fcb)
@@ -18,7 +18,17 @@ namespace Zerodelay
 		Unreliable_Sequenced,
 		Reliable_Newest,
 		Ack,
-		Ack_Reliable_Newest
+		Ack_Reliable_Newest,
+		Ack_Selective,
+		Aggregate,
+		Mtu_Probe,
+		Mtu_Probe_Ack,
+		Reliable_Unordered,
+		Unreliable,
+		Reliable_SubStream,
+		Fec_Parity,
+		Unreliable_Redundant,
+		Ack_Redundant
 	};
 
 
@@ -64,8 +74,8 @@ namespace Zerodelay
 
 	private:
 		void* m_UserPtr;
-		bool m_IsP2P;
-		bool m_IsListening;
+		std::atomic_bool m_IsP2P;			// both read by receive threads to decide on relaying
+		std::atomic_bool m_IsListening;
 		bool m_IsSuperPeer;
 		std::string m_FunctionInError;
 		std::atomic_uint32_t m_CriticalErrors;
@@ -41,6 +41,22 @@ namespace Zerodelay
 		return std::string(buff);
 	#endif
 
+	#if ZERODELAY_POSIXSOCKET
+		i8_t ipBuff[INET6_ADDRSTRLEN] = { 0 };
+		i8_t buff[128];
+		if ( m_SockAddr.sa.sa_family == AF_INET6 )
+		{
+			inet_ntop(AF_INET6, &m_SockAddr.v6.sin6_addr, ipBuff, sizeof(ipBuff));
+			Platform::formatPrint(buff, 128, "[%s]:%d", ipBuff, Util::ntohs(m_SockAddr.v6.sin6_port));
+		}
+		else
+		{
+			inet_ntop(AF_INET, &m_SockAddr.v4.sin_addr, ipBuff, sizeof(ipBuff));
+			Platform::formatPrint(buff, 128, "%s:%d", ipBuff, Util::ntohs(m_SockAddr.v4.sin_port));
+		}
+		return std::string(buff);
+	#endif
+
 		return "";
 	}
 
@@ -95,6 +111,43 @@ namespace Zerodelay
 		}
 	#endif
 
+	#if ZERODELAY_POSIXSOCKET
+		addrinfo hints;
+		addrinfo *addrInfo = nullptr;
+
+		memset(&hints, 0, sizeof(hints));
+
+		hints.ai_family   = AF_UNSPEC; // socket is dual stack, so both Ipv4 and Ipv6 can be connected to
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_protocol = IPPROTO_UDP;
+
+		i8_t portBuff[32];
+		Platform::formatPrint(portBuff, 32, "%d", port);
+
+		m_LastError = getaddrinfo(name.c_str(), portBuff, &hints, &addrInfo);
+		if (m_LastError != 0)
+		{
+			return false;
+		}
+
+		// prefer Ipv4 as only Ipv4 endpoints can be serialized (relayed to other nodes)
+		addrinfo* found = addrInfo;
+		for (addrinfo* inf = addrInfo; inf != nullptr; inf = inf->ai_next)
+		{
+			if ( inf->ai_family == AF_INET )
+			{
+				found = inf;
+				break;
+			}
+		}
+		if ( found )
+		{
+			setFromLowLevelAddr( found->ai_addr, (i32_t)found->ai_addrlen );
+		}
+		freeaddrinfo(addrInfo);
+		return found != nullptr;
+	#endif
+
 		return false;
 	}
 
@@ -111,6 +164,9 @@ namespace Zerodelay
 	#if ZERODELAY_SDLSOCKET
 		return m_IpAddress.port;
 	#endif	
+	#if ZERODELAY_POSIXSOCKET
+		return m_SockAddr.sa.sa_family == AF_INET6 ? m_SockAddr.v6.sin6_port : m_SockAddr.v4.sin_port;
+	#endif
 		return (u16_t)-1;
 	}
 
@@ -127,6 +183,10 @@ namespace Zerodelay
 	#if ZERODELAY_SDLSOCKET
 		return m_IpAddress.host;
 	#endif	
+	#if ZERODELAY_POSIXSOCKET
+		if ( m_SockAddr.sa.sa_family == AF_INET )
+			return m_SockAddr.v4.sin_addr.s_addr;
+	#endif
 		return (u32_t)-1;
 	}
 
@@ -138,6 +198,9 @@ namespace Zerodelay
 	#if ZERODELAY_SDLSOCKET
 		return &m_IpAddress;
 	#endif	
+	#if ZERODELAY_POSIXSOCKET
+		return &m_SockAddr;
+	#endif
 		assert(0);
 		return nullptr;
 	}
@@ -150,6 +213,9 @@ namespace Zerodelay
 	#if ZERODELAY_SDLSOCKET
 		return sizeof(m_IpAddress);
 	#endif	
+	#if ZERODELAY_POSIXSOCKET
+		return m_SockAddr.sa.sa_family == AF_INET6 ? sizeof(m_SockAddr.v6) : sizeof(m_SockAddr.v4);
+	#endif
 		assert(0);
 		return 0;
 	}
@@ -167,8 +233,43 @@ namespace Zerodelay
 		m_IpAddress.host = ip;
 		m_IpAddress.port = port;
 	#endif	
+	#if ZERODELAY_POSIXSOCKET
+		memset(&m_SockAddr, 0, sizeof(m_SockAddr));
+		m_SockAddr.v4.sin_family = AF_INET;
+		m_SockAddr.v4.sin_port = port;
+		m_SockAddr.v4.sin_addr.s_addr = ip;
+	#endif
 	}
 
+#if ZERODELAY_POSIXSOCKET
+	void EndPoint::setFromLowLevelAddr(const void* addr, i32_t addrSize)
+	{
+		// zero all, endpoints are compared with memcmp
+		memset(&m_SockAddr, 0, sizeof(m_SockAddr));
+		const sockaddr_in6* v6 = (const sockaddr_in6*)addr;
+		if ( addrSize >= (i32_t)sizeof(sockaddr_in6) && v6->sin6_family == AF_INET6 )
+		{
+			if ( IN6_IS_ADDR_V4MAPPED(&v6->sin6_addr) )
+			{
+				// Ipv4 peer on dual stack socket, store as Ipv4 so that it equals the resolved Ipv4 address
+				u32_t ip;
+				memcpy( &ip, v6->sin6_addr.s6_addr + 12, 4 );
+				setIpAndPortFromNetworkOrder( ip, v6->sin6_port );
+				return;
+			}
+			m_SockAddr.v6.sin6_family = AF_INET6;
+			m_SockAddr.v6.sin6_port = v6->sin6_port;
+			m_SockAddr.v6.sin6_addr = v6->sin6_addr;
+			m_SockAddr.v6.sin6_scope_id = v6->sin6_scope_id;
+		}
+		else if ( addrSize >= (i32_t)sizeof(sockaddr_in) && ((const sockaddr*)addr)->sa_family == AF_INET )
+		{
+			const sockaddr_in* v4 = (const sockaddr_in*)addr;
+			setIpAndPortFromNetworkOrder( v4->sin_addr.s_addr, v4->sin_port );
+		}
+	}
+#endif
+
 	void EndPoint::setIpAndPortFromHostOrder(u32_t ip, u16_t port)
 	{
 		setIpAndPortFromNetworkOrder(Util::htonl(ip), Util::htonl(port));
@@ -181,6 +282,19 @@ namespace Zerodelay
 		return ::memcmp( a.getLowLevelAddr(), b.getLowLevelAddr(), a.getLowLevelAddrSize() ) ;
 	}
 
+	u32_t EndPoint::getHash() const
+	{
+		// FNV-1a
+		const u8_t* addr = (const u8_t*)getLowLevelAddr();
+		i32_t size = getLowLevelAddrSize();
+		u32_t hash = 2166136261U;
+		for (i32_t i=0; i<size; ++i)
+		{
+			hash = (hash ^ addr[i]) * 16777619U;
+		}
+		return hash;
+	}
+
 	i32_t EndPoint::write(i8_t* buff, i32_t bufSize) const
 	{
 		u16_t port = getPortNetworkOrder();
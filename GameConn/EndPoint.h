@@ -32,6 +32,9 @@ namespace Zerodelay
 
 		void setIpAndPortFromNetworkOrder( u32_t ip, u16_t port ); // network order is big endian
 		void setIpAndPortFromHostOrder( u32_t ip, u16_t port );
+	#if ZERODELAY_POSIXSOCKET
+		void setFromLowLevelAddr( const void* addr, i32_t addrSize ); // Ipv4 mapped Ipv6 addresses are stored as Ipv4
+	#endif
 
 		struct STLCompare
 		{
@@ -40,6 +43,9 @@ namespace Zerodelay
 
 		static i32_t compareLess( const EndPoint& a, const EndPoint& b );
 
+		// Hash of the same bytes that are compared, so equal endpoints have equal hashes.
+		u32_t getHash() const;
+
 		i32_t write( i8_t* buff, i32_t bufSize ) const;
 		i32_t read( const i8_t* buff, i32_t bufSize );
 
@@ -50,6 +56,15 @@ namespace Zerodelay
 		SOCKADDR_INET m_SockAddr;
 	#endif
 
+	#if ZERODELAY_POSIXSOCKET
+		union
+		{
+			sockaddr	 sa;
+			sockaddr_in  v4;
+			sockaddr_in6 v6;
+		} m_SockAddr;
+	#endif
+
 	#if ZERODELAY_SDLSOCKET
 		IPaddress m_IpAddress;
 	#endif
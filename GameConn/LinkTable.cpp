@@ -0,0 +1,133 @@
+#include "LinkTable.h"
+#include "RUDPLink.h"
+#include "EndPoint.h"
+
+#include <cassert>
+
+
+namespace Zerodelay
+{
+	LinkTable::LinkTable():
+		m_Size(0),
+		m_NumUsed(0)
+	{
+		rehash( sm_InitialCapacity );
+	}
+
+	void LinkTable::add(RUDPLink* link)
+	{
+		assert( link && !find( link->getEndPoint() ) );
+		// keep load factor (including tombstones) below 50% so that probe sequences stay short
+		if ( (m_NumUsed+1)*2 > (u32_t)m_ByEndPoint.size() )
+		{
+			// grow if mostly live links, otherwise only clean up the tombstones
+			u32_t capacity = (u32_t)m_ByEndPoint.size();
+			while ( (m_Size+1)*4 > capacity ) capacity *= 2;
+			rehash( capacity );
+		}
+		insert( m_ByEndPoint, link, link->getEndPoint().getHash() );
+		insert( m_ByLinkId, link, hashLinkId( link->id() ) );
+		m_Size++;
+		m_NumUsed++;
+	}
+
+	void LinkTable::remove(RUDPLink* link)
+	{
+		if ( !link || find( link->getEndPoint() ) != link )
+			return;
+		erase( m_ByEndPoint, link, link->getEndPoint().getHash() );
+		erase( m_ByLinkId, link, hashLinkId( link->id() ) );
+		m_Size--;
+	}
+
+	void LinkTable::clear()
+	{
+		// links may already be deleted, so do not rehash them
+		Slot empty = { nullptr, 0, false };
+		m_ByEndPoint.assign( sm_InitialCapacity, empty );
+		m_ByLinkId.assign( sm_InitialCapacity, empty );
+		m_Size = 0;
+		m_NumUsed = 0;
+	}
+
+	RUDPLink* LinkTable::find(const EndPoint& endPoint) const
+	{
+		u32_t hash = endPoint.getHash();
+		u32_t mask = (u32_t)m_ByEndPoint.size()-1;
+		for (u32_t i = hash & mask; ; i = (i+1) & mask)
+		{
+			const Slot& slot = m_ByEndPoint[i];
+			if ( !slot.link && !slot.removed )
+				return nullptr;
+			if ( slot.link && slot.hash == hash && slot.link->getEndPoint() == endPoint )
+				return slot.link;
+		}
+	}
+
+	RUDPLink* LinkTable::find(u32_t linkId, const EndPoint& endPoint) const
+	{
+		u32_t hash = hashLinkId( linkId );
+		u32_t mask = (u32_t)m_ByLinkId.size()-1;
+		for (u32_t i = hash & mask; ; i = (i+1) & mask)
+		{
+			const Slot& slot = m_ByLinkId[i];
+			if ( !slot.link && !slot.removed )
+				return nullptr;
+			if ( slot.link && slot.link->id() == linkId && slot.link->getEndPoint() == endPoint )
+				return slot.link;
+		}
+	}
+
+	u32_t LinkTable::hashLinkId(u32_t linkId)
+	{
+		// link ids are mostly rand() which only covers 15 bits on some platforms, so mix all bits (murmur3 finalizer)
+		linkId ^= linkId >> 16;
+		linkId *= 0x85ebca6b;
+		linkId ^= linkId >> 13;
+		linkId *= 0xc2b2ae35;
+		linkId ^= linkId >> 16;
+		return linkId;
+	}
+
+	void LinkTable::rehash(u32_t capacity)
+	{
+		std::vector<Slot> old;
+		old.swap( m_ByEndPoint );
+		Slot empty = { nullptr, 0, false };
+		m_ByEndPoint.assign( capacity, empty );
+		m_ByLinkId.assign( capacity, empty );
+		m_NumUsed = 0;
+		for (auto& slot : old)
+		{
+			if ( !slot.link )
+				continue;
+			insert( m_ByEndPoint, slot.link, slot.hash );
+			insert( m_ByLinkId, slot.link, hashLinkId( slot.link->id() ) );
+			m_NumUsed++;
+		}
+	}
+
+	void LinkTable::insert(std::vector<Slot>& slots, RUDPLink* link, u32_t hash)
+	{
+		u32_t mask = (u32_t)slots.size()-1;
+		u32_t i = hash & mask;
+		while ( slots[i].link ) i = (i+1) & mask; // reuse first empty slot or tombstone
+		slots[i].link = link;
+		slots[i].hash = hash;
+		slots[i].removed = false;
+	}
+
+	void LinkTable::erase(std::vector<Slot>& slots, RUDPLink* link, u32_t hash)
+	{
+		u32_t mask = (u32_t)slots.size()-1;
+		for (u32_t i = hash & mask; slots[i].link || slots[i].removed; i = (i+1) & mask)
+		{
+			if ( slots[i].link == link )
+			{
+				slots[i].link = nullptr;
+				slots[i].removed = true;
+				return;
+			}
+		}
+	}
+}
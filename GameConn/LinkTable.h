@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Zerodelay.h"
+
+#include <vector>
+
+
+namespace Zerodelay
+{
+	// Open addressing (linear probing) hash table of links. Indexed by endpoint and by the link id that every packet carries.
+	// Link ids are not unique among peers, so a lookup by id also requires the endpoint to match.
+	// Not thread safe.
+	class LinkTable
+	{
+		struct Slot
+		{
+			class RUDPLink* link;	// nullptr if empty
+			u32_t hash;
+			bool  removed;			// tombstone, probing continues past it
+		};
+
+	public:
+		static const u32_t sm_InitialCapacity = 64; // power of two
+
+		LinkTable();
+
+		void add( class RUDPLink* link );
+		void remove( class RUDPLink* link );
+		void clear();
+		class RUDPLink* find( const struct EndPoint& endPoint ) const;
+		class RUDPLink* find( u32_t linkId, const struct EndPoint& endPoint ) const;
+		u32_t size() const { return m_Size; }
+
+		static u32_t hashLinkId( u32_t linkId );
+
+	private:
+		void rehash( u32_t capacity );
+		static void insert( std::vector<Slot>& slots, class RUDPLink* link, u32_t hash );
+		static void erase( std::vector<Slot>& slots, class RUDPLink* link, u32_t hash );
+
+		std::vector<Slot> m_ByEndPoint;
+		std::vector<Slot> m_ByLinkId;
+		u32_t m_Size;
+		u32_t m_NumUsed;	// including tombstones
+	};
+}
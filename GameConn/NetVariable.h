@@ -7,6 +7,8 @@
 
 namespace Zerodelay
 {
+	enum class EVarControl;
+
 	class NetVariable
 	{
 	public:
@@ -14,7 +16,7 @@ namespace Zerodelay
 		~NetVariable();
 
 		const ZEndpoint* getOwner() const;
-		enum class EVarControl getVarControl() const;
+		EVarControl getVarControl() const;
 		u32_t getGroupId() const;
 		bool read( const i8_t*& buff, i32_t& buffLen);
 		i8_t* data();
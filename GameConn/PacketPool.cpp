@@ -0,0 +1,183 @@
+#include "PacketPool.h"
+
+#include <cassert>
+#include <mutex>
+
+
+namespace Zerodelay
+{
+	// Covers acks, a full size datagram (ZERODELAY_BUFF_SIZE), a receive buffer (ZERODELAY_BUFF_RECV_SIZE) and reassembled messages.
+	const i32_t PacketPool::sm_SizeClasses[PacketPool::sm_NumSizeClasses] = { 64, 256, 1024, 4096, 16384, 65536 };
+
+	struct SharedLists
+	{
+		std::mutex mutex;
+		PacketPool::FreeList lists[PacketPool::sm_NumSizeClasses] = { };
+
+		~SharedLists()
+		{
+			for (auto& list : lists)
+			{
+				while ( list.head )
+				{
+					PacketPool::Buffer* next = list.head->next;
+					delete [] (i8_t*)list.head;
+					list.head = next;
+				}
+			}
+		}
+
+		static SharedLists& get()
+		{
+			static SharedLists shared;
+			return shared;
+		}
+	};
+
+	struct ThreadCache
+	{
+		PacketPool::FreeList lists[PacketPool::sm_NumSizeClasses] = { };
+
+		ThreadCache()
+		{
+			SharedLists::get(); // construct before, so that it is destructed after
+		}
+
+		~ThreadCache()
+		{
+			for (i32_t i=0; i<PacketPool::sm_NumSizeClasses; ++i)
+			{
+				moveBuffers( lists[i], i, lists[i].count );
+			}
+		}
+
+		// move num buffers from the front of this thread's list to the shared list
+		void moveBuffers( PacketPool::FreeList& list, i32_t sizeClass, i32_t num )
+		{
+			if ( num <= 0 ) return;
+			PacketPool::Buffer* first = list.head;
+			PacketPool::Buffer* last  = first;
+			for (i32_t i=1; i<num; ++i) last = last->next;
+			list.head   = last->next;
+			list.count -= num;
+			SharedLists& shared = SharedLists::get();
+			std::lock_guard<std::mutex> lock(shared.mutex);
+			last->next = shared.lists[sizeClass].head;
+			shared.lists[sizeClass].head   = first;
+			shared.lists[sizeClass].count += num;
+		}
+
+		// take up to num buffers from the shared list
+		void takeBuffers( PacketPool::FreeList& list, i32_t sizeClass, i32_t num )
+		{
+			SharedLists& shared = SharedLists::get();
+			std::lock_guard<std::mutex> lock(shared.mutex);
+			PacketPool::FreeList& sharedList = shared.lists[sizeClass];
+			while ( num-- > 0 && sharedList.head )
+			{
+				PacketPool::Buffer* buffer = sharedList.head;
+				sharedList.head = buffer->next;
+				sharedList.count--;
+				buffer->next = list.head;
+				list.head = buffer;
+				list.count++;
+			}
+		}
+
+		static ThreadCache& get()
+		{
+			static thread_local ThreadCache cache;
+			return cache;
+		}
+	};
+
+	i8_t* PacketPool::alloc(i32_t size)
+	{
+		assert( size >= 0 );
+		Buffer* buffer = nullptr;
+		i32_t sizeClass = sizeClassFor( size );
+		if ( sizeClass >= 0 )
+		{
+			ThreadCache& cache = ThreadCache::get();
+			FreeList& list = cache.lists[sizeClass];
+			if ( !list.head )
+			{
+				cache.takeBuffers( list, sizeClass, sm_MaxThreadCached/2 );
+			}
+			if ( list.head )
+			{
+				buffer = list.head;
+				list.head = buffer->next;
+				list.count--;
+			}
+			else
+			{
+				buffer = (Buffer*) new i8_t[sm_HeaderSize + sm_SizeClasses[sizeClass]];
+			}
+		}
+		else
+		{
+			buffer = (Buffer*) new i8_t[sm_HeaderSize + size];
+		}
+		buffer->refCount.store( 1, std::memory_order_relaxed );
+		buffer->sizeClass = sizeClass;
+		buffer->next = nullptr;
+		return payload( buffer );
+	}
+
+	void PacketPool::addRef(const i8_t* data)
+	{
+		assert( data );
+		header( data )->refCount.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	void PacketPool::release(const i8_t* data)
+	{
+		if ( !data ) return;
+		Buffer* buffer = header( data );
+		i32_t prev = buffer->refCount.fetch_sub( 1, std::memory_order_acq_rel );
+		assert( prev > 0 );
+		if ( prev == 1 )
+		{
+			recycle( buffer );
+		}
+	}
+
+	i32_t PacketPool::capacity(const i8_t* data)
+	{
+		i32_t sizeClass = header( data )->sizeClass;
+		return sizeClass >= 0 ? sm_SizeClasses[sizeClass] : -1;
+	}
+
+	bool PacketPool::isShared(const i8_t* data)
+	{
+		return header( data )->refCount.load( std::memory_order_acquire ) > 1;
+	}
+
+	i32_t PacketPool::sizeClassFor(i32_t size)
+	{
+		for (i32_t i=0; i<sm_NumSizeClasses; ++i)
+		{
+			if ( size <= sm_SizeClasses[i] ) return i;
+		}
+		return -1;
+	}
+
+	void PacketPool::recycle(Buffer* buffer)
+	{
+		if ( buffer->sizeClass < 0 )
+		{
+			delete [] (i8_t*)buffer;
+			return;
+		}
+		ThreadCache& cache = ThreadCache::get();
+		FreeList& list = cache.lists[buffer->sizeClass];
+		buffer->next = list.head;
+		list.head = buffer;
+		list.count++;
+		if ( list.count > sm_MaxThreadCached )
+		{
+			cache.moveBuffers( list, buffer->sizeClass, sm_MaxThreadCached/2 );
+		}
+	}
+}
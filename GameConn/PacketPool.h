@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Zerodelay.h"
+
+#include <atomic>
+
+
+namespace Zerodelay
+{
+	// Recycles packet buffers in a few size classes instead of doing a new[]/delete[] per packet.
+	// A buffer is handed out as a plain data pointer, preceded by a small header with a reference count.
+	// The buffer goes back to the pool when the last reference is released, from whatever thread that happens on.
+	// Released buffers go to a small cache of the releasing thread first and overflow to a shared list per size class,
+	// so that the send, receive and main thread rarely contend.
+	// Sizes above the largest class are allocated from the heap (but still ref counted).
+	class PacketPool
+	{
+	public:
+		static const i32_t sm_NumSizeClasses = 6;
+		static const i32_t sm_SizeClasses[sm_NumSizeClasses];
+		static const i32_t sm_MaxThreadCached = 64;	// per size class, half is moved to the shared list when exceeded
+
+		static i8_t* alloc( i32_t size );			// reference count starts at 1
+		static void addRef( const i8_t* data );
+		static void release( const i8_t* data );	// nullptr is ignored
+		static i32_t capacity( const i8_t* data );
+		static bool isShared( const i8_t* data );	// more than one reference
+
+	private:
+		struct Buffer
+		{
+			std::atomic<i32_t> refCount;
+			i32_t sizeClass;	// -1 if allocated from heap
+			Buffer* next;		// free list link
+		};
+		static const i32_t sm_HeaderSize = 32; // keeps data aligned, >= sizeof(Buffer)
+
+		struct FreeList
+		{
+			Buffer* head;
+			i32_t count;
+		};
+
+		static Buffer* header( const i8_t* data ) { return (Buffer*)(data - sm_HeaderSize); }
+		static i8_t* payload( Buffer* buffer ) { return (i8_t*)buffer + sm_HeaderSize; }
+		static i32_t sizeClassFor( i32_t size );
+		static void recycle( Buffer* buffer );
+
+		friend struct ThreadCache;
+		friend struct SharedLists;
+	};
+}
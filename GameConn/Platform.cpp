@@ -2,12 +2,22 @@
 
 #include "Platform.h"
 #include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <thread>
 
 #if ZERODELAY_SDL
 	#include "SDL.h"
 	#include "SDL_net.h"
 #endif
 
+#if ZERODELAY_POSIXSOCKET
+	#include <dlfcn.h>
+#endif
+
 
 namespace Zerodelay
 {
@@ -104,6 +114,9 @@ namespace Zerodelay
 			HMODULE hModule = ::GetModuleHandle(NULL);
 			pf = ::GetProcAddress( hModule, name );
 		#endif
+		#if ZERODELAY_POSIXSOCKET
+			pf = ::dlsym(RTLD_DEFAULT, name); // executable must export its symbols (-rdynamic)
+		#endif
 	#endif
 
 			if ( pf )
@@ -128,7 +141,7 @@ namespace Zerodelay
 		vsprintf_s(buff, 2048, fmt, myargs);
 		strcat_s(buff, 2048, "\n");
 #else
-		vsprintf(buff, fmt, myargs);
+		vsnprintf(buff, 2047, fmt, myargs);
 		strcat(buff, "\n");
 #endif
 		va_end(myargs);
@@ -147,9 +160,14 @@ namespace Zerodelay
 			time_t rawtime;
 			struct tm timeinfo;
 			time (&rawtime);
-			localtime_s(&timeinfo, &rawtime);
 			i8_t asciitime[128];
+		#if ZERODELAY_SECURECRT
+			localtime_s(&timeinfo, &rawtime);
 			asctime_s(asciitime, 128, &timeinfo);
+		#else
+			localtime_r(&rawtime, &timeinfo);
+			asctime_r(&timeinfo, asciitime);
+		#endif
 			i8_t* p = strstr(asciitime, "\n");
 			if ( p )
 				*p ='\0';
@@ -184,13 +202,12 @@ namespace Zerodelay
 			assert(false);
 			return false;
 		}
-		i32_t res;
-	#ifdef ZERODELAY_SECURECRT
-		res = memcpy_s( dst, dstSize, src, srcSize );
+	#if ZERODELAY_SECURECRT
+		i32_t res = memcpy_s( dst, dstSize, src, srcSize );
+		assert(res == 0);
 	#else
-		res = memcpy( dst, src, srcSize );
+		memcpy( dst, src, srcSize );
 	#endif
-		assert(res == 0);
 		return true;
 	}
 
@@ -201,7 +218,7 @@ namespace Zerodelay
 	#if ZERODELAY_SECURECRT
 		vsprintf_s(dst, dstSize, fmt, myargs);
 	#else
-		vsprintf(dst, fmt, myargs);
+		vsnprintf(dst, dstSize, fmt, myargs);
 	#endif
 		va_end(myargs);
 		return true;
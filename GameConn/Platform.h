@@ -2,17 +2,25 @@
 
 // On/Off switches
 #define ZERODELAY_DEBUG									(1)
-#define ZERODELAY_INCWINDOWS							(1)
-#define ZERODELAY_SECURECRT								(1)
 #define ZERODELAY_FAKESOCKET							(0)
 #define ZERODELAY_WIN32SOCKET							(0)
-#define ZERODELAY_SDLSOCKET								(1)
-#define ZERODELAY_SDL									(1)
 #define ZERODELAY_LIL_ENDIAN							(1)
 #define ZERODELAY_BIG_ENDIAN							(0)
+#if _WIN32
+	#define ZERODELAY_INCWINDOWS						(1)
+	#define ZERODELAY_SECURECRT							(1)
+	#define ZERODELAY_SDLSOCKET							(1)
+	#define ZERODELAY_SDL								(1)
+	#define ZERODELAY_POSIXSOCKET						(0)
+#else // Linux/Posix, no SDL dependency
+	#define ZERODELAY_INCWINDOWS						(0)
+	#define ZERODELAY_SECURECRT							(0)
+	#define ZERODELAY_SDLSOCKET							(0)
+	#define ZERODELAY_SDL								(0)
+	#define ZERODELAY_POSIXSOCKET						(1)
+#endif
 
 // Constants
-#define ZERODELAY_INITALFRAGSIZE						(1900)
 #define ZERODELAY_BUFF_SIZE								(2048)	// send buff size
 #define ZERODELAY_BUFF_RECV_SIZE						(3000)  // recv buff size
 
@@ -38,6 +46,19 @@
 	#pragma comment(lib, "User32.lib")
 #endif
 
+#if ZERODELAY_POSIXSOCKET
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <netdb.h>
+	#include <unistd.h>
+	#undef htonl
+	#undef htons
+	#undef ntohl
+	#undef ntohs
+#endif
+
 #if ZERODELAY_SDL // if windows and SDL 
 	#include "../3rdParty/SDL2/include/SDL.h"
 	#include "../3rdParty/SDL2_net/include/SDL_net.h"
@@ -47,6 +68,8 @@
 
 
 
+#include <climits>
+#include <cstring>
 #include <string>
 #include <map>
 #include <mutex>
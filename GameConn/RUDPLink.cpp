@@ -4,6 +4,8 @@
 #include "Util.h"
 #include "CoreNode.h"
 #include "BinSerializer.h"
+#include "CongestionControl.h"
+#include "PacketPool.h"
 
 #include <algorithm>
 #include <cassert>
@@ -13,85 +15,194 @@ namespace Zerodelay
 {
 	RUDPLink::RUDPLink(RecvNode* recvNode, const EndPoint& endPoint, u32_t linkId):
 		m_RecvNode(recvNode),
-		m_LinkId(linkId),
 		m_Connected(false),
+		m_CompactHdr(false),
+		m_LinkId(linkId),
 		m_EndPoint(endPoint),
 		m_BlockNewSends(false),
-		m_RetransmitWaitingTime(0),
+		m_NewestAckedSendTS(0),
+		m_ReliableWindow(recvNode->getReliableWindow()),
+		m_RetransmitTimerBase(0),
+		m_Pacer(sm_MtuMaxSize),
+		m_BytesInFlight(0),
+		m_HasReliableBacklog(false),
+		m_NumReorderPackets(0),
+		m_SackPending(false),
+		m_CoalesceLen(0),
+		m_CoalesceCount(0),
+		m_CoalesceDeadlineTS(0),
+		m_CoalesceCompact(false),
+		m_HasRttSample(false),
+		m_SmoothedRttF((float)sm_InitialRttMs),
+		m_RttVarianceF(sm_InitialRttMs*.5f),
+		m_SmoothedRtt(sm_InitialRttMs),
+		m_RttVariance(sm_InitialRttMs/2),
+		m_RetransmitTimeout(sm_InitialRttMs*3),
 		m_PacketLossPercentage(0),
-		m_FragmentSize(ZERODELAY_INITALFRAGSIZE),
+		m_FragmentSize(sm_MtuBaseSize - off_Norm_Data),
+		m_MtuSize(sm_MtuBaseSize),
+		m_MtuSearchHigh(sm_MtuMaxSize+1),
+		m_MtuProbeSize(0),
+		m_MtuProbeCount(0),
+		m_MtuProbeTS(0),
+		m_MtuSearchDoneTS(0),
+		m_MtuProbeAckSize(0),
+		m_RecvShard(-1),
+		m_RecvBuffer(nullptr),
+		m_RecvCompact(false),
 		m_IsPendingDelete(false),
 		m_MarkDeleteTS(0)
 	{
+		m_CongestionControl = ICongestionControl::create( recvNode->getCongestionControl(), sm_MtuMaxSize );
 		m_SendSeq_reliable_newest = 0;
 		m_RecvSeq_reliable_newest = 0;
 		m_RecvSeq_reliable_newest_ack = 0;
-		m_RecvSeq_reliable_newest = 0;
-		for (i32_t i=0; i<sm_NumChannels; ++i)
+		m_RelNewestAckPending = false;
+		m_AcksScheduled = false;
+		m_QueuedBytes_reliable_newest = 0;
+		for (i32_t i=0; i<sm_NumChannels+1; ++i)
+		{
+			m_SendBudgetBytes[i] = recvNode->getSendBudgetBytes( i-1 );
+			m_SendBudgetMessages[i] = recvNode->getSendBudgetMessages( i-1 );
+		}
+		for (i32_t i=0; i<(i32_t)ELinkTimer::Count; ++i)
+		{
+			TimerWheel::initTimer( m_Timers[i], this, i );
+		}
+		for (i32_t i=0; i<sm_NumStreams; ++i)
 		{
 			m_SendSeq_reliable[i] = 0;
+			m_RetransmitBase_reliable[i] = 0;
+			m_RetransmitNext_reliable[i] = 0;
+			m_HighestAcked_reliable[i] = ~0U; // none yet, is one before first sequence
 			m_SendSeq_unreliable[i] = 0;
+			m_RecvSeq_unreliable[i] = 0;
 			m_RecvSeq_reliable[i] = 0;
-			m_RecvSeq_reliable[i] = 0;
+			m_SackLatest[i] = 0;
+			m_SackMask[i]  = 0;
+			m_SackValid[i] = false;
+			m_SackDirty[i] = false;
+		}
+		for (auto& pruneSize : m_SubStreamPruneSize) pruneSize = sm_SubStreamMinPruneSize;
+		for (i32_t i=0; i<sm_NumChannels; ++i)
+		{
+			m_FecGroupSize[i] = recvNode->getFecGroupSize( i );
+			m_FecSend[i].firstSeq = 0;
+			m_FecSend[i].lenXor = 0;
+			m_FecSend[i].count = 0;
+			m_FecSend[i].compact = false;
+			m_Redundancy[i] = recvNode->getRedundancy( i );
+			m_SendSeq_redundant[i] = 0;
+			m_RedundantAcked[i] = 0;
+			m_RecvSeq_redundant[i] = 0;
+			m_RedundantAckPending[i] = false;
+			m_QueuedBytes[i] = 0;
+			m_QueuedMessages[i] = 0;
 		}
 	}
 
 	RUDPLink::~RUDPLink()
 	{
-		for (auto & queue : m_RetransmitQueue_reliable) for (auto& pack : queue) delete [] pack.data;
-		for (auto & queue : m_RecvQueue_reliable_order) for (auto& seqPacketPair : queue) delete [] seqPacketPair.second.first.data;
-		for (auto & queue : m_RecvQueue_unreliable_sequenced ) for (auto& pack : queue) delete [] pack.data;
+		for (auto & ring : m_RetransmitRing_reliable) for (auto& item : ring) if ( item.inFlight ) releaseSendPacket( item.pack );
+		for (auto & queue : m_SendBacklog_reliable) for (auto& pack : queue) releaseSendPacket( pack );
+		for (auto & ring : m_ReorderRing_reliable) for (auto& slot : ring) if ( slot.filled && !slot.delivered ) PacketPool::release( slot.pack.buffer );
+		for (auto & assembly : m_Assembly_reliable) for (auto& pack : assembly) PacketPool::release( pack.buffer );
+		for (auto & held : m_SubStreamHeld) for (auto& seqPackPair : held) PacketPool::release( seqPackPair.second.buffer );
+		for (auto & history : m_FecHistory) for (auto& slot : history) PacketPool::release( slot.buffer );
+		Packet pack;
+		while ( poll( pack ) ) PacketPool::release( pack.buffer );
 		for (auto & groupIdGroupPair : m_SendQueue_reliable_newest ) for (auto & groupItem : groupIdGroupPair.second.groupItems) delete [] groupItem.data;
-		for (auto & buffer : m_Ureliable_fragments) for (auto& pair : buffer) delete [] pair.second.data;
-		for (auto & buffer : m_Reliable_fragments) for (auto& pair : buffer) delete [] pair.second.data;
+		for (auto & ring : m_FragmentRing_unreliable) for (auto& slot : ring) if ( slot.filled ) PacketPool::release( slot.pack.buffer );
+		delete m_CongestionControl;
 	}
 
 	ESendCallResult RUDPLink::addToSendQueue(u8_t id, const i8_t* data, i32_t len, EHeaderPacketType packetType, u8_t channel, bool relay,
-											 u32_t* sequence, u32_t* numFragments)
+											 u32_t* sequence, u32_t* numFragments, u32_t subStream, const i8_t* sharedPayload)
 	{
+		std::lock_guard<std::mutex> sendLock(m_SendMutex);
 		if ( m_BlockNewSends ) // discard new packets in this case
 		{
 			Platform::log("WARNING: Trying to send id %d with sendType %d while send is blocked.", id, (u32_t)packetType);
 			return ESendCallResult::NotSent;
 		}
 		// user not allowed to send acks
-		if ( packetType == EHeaderPacketType::Ack || packetType == EHeaderPacketType::Reliable_Newest )
+		if ( packetType == EHeaderPacketType::Ack || packetType == EHeaderPacketType::Reliable_Newest || packetType == EHeaderPacketType::Ack_Redundant )
 		{
 			assert( false && "Invalid packet type" );
 			m_RecvNode->getCoreNode()->setCriticalError( ECriticalError::InvalidLogic, ZERODELAY_FUNCTION_LINE );
 			return ESendCallResult::InternalError;
 		}
-		std::vector<Packet> packs;
-		serializeNormalPacket( packs, m_LinkId, packetType, id, data, len, m_FragmentSize, channel, relay );
-		if ( packetType == EHeaderPacketType::Reliable_Ordered )
+		if ( packetType == EHeaderPacketType::Unreliable_Redundant )
+		{
+			return sendRedundant( id, data, len, channel, relay );
+		}
+		bool bReliable = packetType == EHeaderPacketType::Reliable_Ordered || packetType == EHeaderPacketType::Reliable_Unordered ||
+						 packetType == EHeaderPacketType::Reliable_SubStream;
+		// only user messages are held back, connection and system messages must always get through
+		if ( bReliable && id >= USER_ID_OFFSET )
+		{
+			std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
+			if ( !hasSendBudget( channel, len ) )
+				return ESendCallResult::WouldBlock;
+		}
+		static thread_local std::vector<Packet> packs; // reused, keeps its capacity
+		packs.clear();
+		if ( packetType == EHeaderPacketType::Reliable_SubStream )
+		{
+			// sub-stream header goes in front of the data, the distance to the previous message is set once sequenced
+			static thread_local std::vector<i8_t> subStreamData;
+			subStreamData.resize( hdr_Sub_Size + len );
+			*(u32_t*)&subStreamData[off_Sub_Id] = subStream;
+			*(u32_t*)&subStreamData[off_Sub_Dist] = 0;
+			if ( len > 0 ) Platform::memCpy( subStreamData.data() + hdr_Sub_Size, len, data, len );
+			data = subStreamData.data();
+			len += hdr_Sub_Size;
+		}
+		i32_t stream = getStream( packetType, channel );
+		// compact header has no room for the unordered and unsequenced types
+		bool bCompact = m_CompactHdr && (packetType == EHeaderPacketType::Reliable_Ordered || packetType == EHeaderPacketType::Unreliable_Sequenced);
+		i32_t fragmentSize = m_FragmentSize + (bCompact ? off_Norm_Data - off_Cmp_Norm_Data : 0);
+		serializeNormalPacket( packs, m_LinkId, packetType, id, data, len, fragmentSize, channel, relay, bCompact, sharedPayload );
+		if ( bReliable )
 		{
 			// add to resend queue (reliable)
 			{
 				if (sequence)
 				{
-					*sequence = m_SendSeq_reliable[channel];
+					*sequence = m_SendSeq_reliable[stream];
 					*numFragments = (u32_t)packs.size();
 				}
 				std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
+				if ( packetType == EHeaderPacketType::Reliable_SubStream )
+				{
+					u32_t firstSeq = m_SendSeq_reliable[stream];
+					linkSubStream( packs.front(), stream, channel, subStream, firstSeq, firstSeq + (u32_t)packs.size()-1 );
+				}
 				for (auto& fragment : packs)
 				{
-					*(u32_t*)&fragment.data[off_Norm_Seq] = m_SendSeq_reliable[channel]++;
-					m_RetransmitQueue_reliable[channel].emplace_back( fragment );
+					writeSequence( fragment, m_SendSeq_reliable[stream]++ );
+					m_SendBacklog_reliable[stream].emplace_back( fragment );
+					m_QueuedBytes[channel] += fragment.len;
 				}
-			}
-			// immediate send after adding to resend queue as we need the sequence printed in the data
-			for (auto& fragment : packs)
-			{
-				m_RecvNode->getSocket()->send( m_EndPoint, fragment.data, fragment.len );
+				m_QueuedMessages[channel]++;
+				m_HasReliableBacklog = true;
+				// immediate send of what fits in the window, remainder is sent when acks arrive
+				flushReliableBacklog( m_RecvNode->getSocket() );
+				// send thread works out when the pacer allows the remainder, otherwise only the retransmission timer is needed
+				m_RecvNode->scheduleLink( this, ELinkTimer::Send, m_HasReliableBacklog ? 0 : getRetransmitTimeout() );
 			}
 		}
 		else
 		{
+			bool bFec = (packetType == EHeaderPacketType::Unreliable_Sequenced && m_FecGroupSize[channel] > 0);
 			for (auto& fragment : packs)
 			{
-			//	Platform::log("Sent unreliable seq: %d, chan %d.", m_SendSeq_unreliable[channel], channel);
-				*(u32_t*)&fragment.data[off_Norm_Seq] = m_SendSeq_unreliable[channel]++;
-				m_RecvNode->getSocket()->send( m_EndPoint, fragment.data, fragment.len );
+			//	Platform::log("Sent unreliable seq: %d, chan %d.", m_SendSeq_unreliable[stream], channel);
+				u32_t seq = m_SendSeq_unreliable[stream]++;
+				writeSequence( fragment, seq );
+				sendPacket( m_RecvNode->getSocket(), fragment );
+				if ( bFec ) addToFecGroup( fragment, channel, seq );
+				releaseSendPacket( fragment ); // not kept for resend
 			}
 		}
 		return ESendCallResult::Succes;
@@ -111,14 +222,23 @@ namespace Zerodelay
 			m_RecvNode->getCoreNode()->setCriticalError( ECriticalError::SerializationError, ZERODELAY_FUNCTION_LINE );
 			return;
 		}
+		u32_t queuedBytes, queuedMessages;
+		getQueuedSend( -1, queuedBytes, queuedMessages );
 		std::lock_guard<std::mutex> lock(m_ReliableNewestQueueMutex);
 		auto it = m_SendQueue_reliable_newest.find( groupId );
 		if ( it == m_SendQueue_reliable_newest.end() )
 		{
+			// only new groups grow the queue, existing ones are overwritten in place
+			if ( id >= USER_ID_OFFSET && queuedBytes > 0 && m_SendBudgetBytes[0] > 0 && queuedBytes + len > m_SendBudgetBytes[0] )
+			{
+				Platform::log("WARNING: Reliable newest group %d dropped, send budget of link is full.", groupId);
+				return;
+			}
+			m_QueuedBytes_reliable_newest += len;
 			// item in group
 			reliableNewestItem item;
 			item.localRevision  = m_SendSeq_reliable_newest;
-			item.remoteRevision = m_SendSeq_reliable_newest;
+			item.remoteRevision = m_SendSeq_reliable_newest-1; // changed
 			item.dataLen = len;
 			item.dataCapacity = len;
 			item.data = new i8_t[len];
@@ -135,17 +255,18 @@ namespace Zerodelay
 				groupItem.remoteRevision = m_SendSeq_reliable_newest;
 			}
 			// copy new item
-			Platform::memCpy(&rd.groupItems[groupBit], sizeof(item), &item, sizeof(item));			
+			Platform::memCpy(&rd.groupItems[(u8_t)groupBit], sizeof(item), &item, sizeof(item));			
 			m_SendQueue_reliable_newest.insert( std::make_pair( groupId, rd ) ); // put in map
 		}
 		else
 		{
 			reliableNewestDataGroup& rd = it->second;
-			reliableNewestItem& item = rd.groupItems[groupBit];
+			reliableNewestItem& item = rd.groupItems[(u8_t)groupBit];
 			item.localRevision = m_SendSeq_reliable_newest; // update to what it will be sent with
 			if ( item.dataCapacity < len )
 			{
 				// cannot recycle this data, delete and reallocate
+				m_QueuedBytes_reliable_newest += len - item.dataCapacity;
 				delete [] item.data;
 				item.data = new i8_t[len];
 				item.dataCapacity = len;
@@ -153,89 +274,174 @@ namespace Zerodelay
 			Platform::memCpy( item.data, len, data, len );
 			item.dataLen = len;
 		}
+		// changes within the interval go out together
+		i32_t delay = m_RecvNode->isLowLatency() ? 0 : m_RecvNode->getReliableNewestInterval();
+		m_RecvNode->scheduleLink( this, ELinkTimer::ReliableNewest, delay );
 	}
 
-	void RUDPLink::blockAllUpcomingSends()
+	void RUDPLink::addToFecGroup(const Packet& pack, u8_t channel, u32_t seq)
 	{
-		m_BlockNewSends = true;
+		fecSendGroup& group = m_FecSend[channel];
+		bool bCompact = isCompactHeader( pack.data );
+		i32_t kTypeOffset = bCompact ? off_Cmp_Type : off_Type;
+		i32_t itemLen = pack.len - kTypeOffset;
+		// a group has consecutive sequences, a packet that does not fit in a parity datagram (fragment of a big message) ends it
+		if ( off_Fec_Data + itemLen > getMaxDatagramSize() )
+		{
+			sendFecParity( channel );
+			return;
+		}
+		if ( group.count > 0 && (group.compact != bCompact || group.firstSeq + group.count != seq) )
+		{
+			sendFecParity( channel );
+		}
+		if ( group.count == 0 )
+		{
+			group.parity.clear();
+			group.firstSeq = seq;
+			group.lenXor = 0;
+			group.compact = bCompact;
+		}
+		if ( (i32_t)group.parity.size() < itemLen )
+		{
+			group.parity.resize( itemLen, 0 );
+		}
+		i32_t hdrLen = pack.len - pack.payloadLen - kTypeOffset;
+		for (i32_t i=0; i<hdrLen; ++i)
+		{
+			group.parity[i] ^= pack.data[kTypeOffset + i];
+		}
+		for (i32_t i=0; i<pack.payloadLen; ++i)
+		{
+			group.parity[hdrLen + i] ^= pack.payload[i];
+		}
+		group.lenXor ^= (u16_t)itemLen;
+		group.count++;
+		if ( group.count >= m_FecGroupSize[channel] )
+		{
+			sendFecParity( channel );
+		}
 	}
 
-	void RUDPLink::beginPoll()
+	void RUDPLink::sendFecParity(u8_t channel)
 	{
-		return m_RecvQueuesMutex.lock();
+		fecSendGroup& group = m_FecSend[channel];
+		if ( group.count == 0 )
+			return;
+		i8_t buff[ZERODELAY_BUFF_SIZE];
+		i32_t parityLen = (i32_t)group.parity.size();
+		*(u32_t*)buff = m_LinkId;
+		buff[off_Type] = (i8_t)EHeaderPacketType::Fec_Parity;
+		buff[off_Fec_Chan]  = (i8_t)channel;
+		*(u32_t*)&buff[off_Fec_Seq] = group.firstSeq;
+		buff[off_Fec_Count] = (i8_t)group.count;
+		buff[off_Fec_Flags] = group.compact ? 1 : 0;
+		*(u16_t*)&buff[off_Fec_LenXor] = group.lenXor;
+		Platform::memCpy( buff + off_Fec_Data, sizeof(buff) - off_Fec_Data, group.parity.data(), parityLen );
+		group.count = 0;
+		// after the coalesced packets of the group, otherwise it arrives before them and cannot rebuild anything
+		// not coalesced with the last packet of the group, so that a single lost datagram does not take out both
+		ISocket* socket = m_RecvNode->getSocket();
+		flush( socket );
+		sendWithAcks( socket, buff, off_Fec_Data + parityLen );
 	}
 
-	bool RUDPLink::poll(Packet& pack)
+	ESendCallResult RUDPLink::sendRedundant(u8_t id, const i8_t* data, i32_t len, u8_t channel, bool relay)
 	{
-		// try reliable ordered packets
-		for (i32_t chn=0; chn<sm_NumChannels; ++chn)
+		auto& history = m_RedundantHistory[channel];
+		// forget what the remote has, keep at most the configured number of previous messages (buffers are recycled)
+		std::vector<i8_t> recycled;
+		u32_t acked = m_RedundantAcked[channel];
+		while ( !history.empty() && (!isSequenceNewer( history.front().seq, acked ) || history.size() > m_Redundancy[channel]) )
 		{
-			std::map<u32_t, std::pair<Packet, u32_t>>& queue = m_RecvQueue_reliable_order[chn];
-			if ( !queue.empty() )
-			{
-				auto it = queue.find( (u32_t&) m_RecvSeq_reliable[chn] );
-				if ( it != queue.end() )
-				{
-					pack = it->second.first;
-					m_RecvSeq_reliable[chn] += it->second.second; // for unfragmented packets 1, numFragments otherwise
-					queue.erase( it );
-					return true;
-				}
-			}
+			recycled.swap( history.front().data );
+			history.pop_front();
 		}
-		// try unreliable sequenced packets
-		for (auto& queue : m_RecvQueue_unreliable_sequenced)
+		history.emplace_back();
+		redundantSendItem& item = history.back();
+		item.data.swap( recycled );
+		item.data.resize( len+1 );
+		item.data[0] = (i8_t)id;
+		if ( len > 0 ) Platform::memCpy( item.data.data()+1, len, data, len );
+		item.seq = m_SendSeq_redundant[channel];
+
+		i8_t buff[ZERODELAY_BUFF_SIZE];
+		*(u32_t*)buff = m_LinkId;
+		buff[off_Type] = (i8_t)EHeaderPacketType::Unreliable_Redundant;
+		buff[off_Red_ChanNFlags] = (i8_t)(channel | (((i8_t)relay) << 3));
+		*(u32_t*)&buff[off_Red_Seq] = item.seq;
+		i32_t maxSize = getMaxDatagramSize();
+		i32_t offset  = off_Red_Data;
+		u32_t num = 0;
+		const std::vector<i8_t>* ref = nullptr;
+		for (auto it = history.rbegin(); it != history.rend(); ++it)
 		{
-			if ( !queue.empty() )
-			{
-				pack = queue.front();
-				queue.pop_front();
-				return true;
-			}
+			const std::vector<i8_t>& msg = it->data;
+			i32_t encLen = encodeDelta( buff + offset + hdr_Red_Item_Size, maxSize - offset - hdr_Red_Item_Size, msg.data(), (i32_t)msg.size(),
+										ref ? ref->data() : nullptr, ref ? (i32_t)ref->size() : 0 );
+			if ( encLen < 0 )
+				break; // older ones do not fit
+			*(u16_t*)&buff[offset] = (u16_t)msg.size();
+			*(u16_t*)&buff[offset+2] = (u16_t)encLen;
+			offset += hdr_Red_Item_Size + encLen;
+			ref = &msg;
+			num++;
 		}
-		// try reliable newest packets
-		if ( !m_RecvQueue_reliable_newest.empty() )
+		if ( num == 0 )
 		{
-			pack = m_RecvQueue_reliable_newest.front();
-			m_RecvQueue_reliable_newest.pop_front();
-			return true;
+			Platform::log("WARNING: Redundant message with id %d and len %d does not fit in a datagram, it is not fragmented.", id, len);
+			history.pop_back();
+			return ESendCallResult::NotSent;
 		}
-		// no packets
-		return false;
+		buff[off_Red_Num] = (i8_t)num;
+		m_SendSeq_redundant[channel]++;
+		// not coalesced, input should not wait for the coalesce delay
+		flush( m_RecvNode->getSocket() );
+		sendWithAcks( m_RecvNode->getSocket(), buff, offset );
+		return ESendCallResult::Succes;
 	}
 
-	void RUDPLink::endPoll()
+	void RUDPLink::blockAllUpcomingSends()
+	{
+		m_BlockNewSends = true;
+	}
+
+	bool RUDPLink::poll(Packet& pack)
 	{
-		m_RecvQueuesMutex.unlock();
+		// reliable ordered first, then unreliable sequenced, then reliable newest
+		return m_RecvRing_reliable_order.pop( pack ) ||
+			   m_RecvRing_unreliable_sequenced.pop( pack ) ||
+			   m_RecvRing_reliable_newest.pop( pack );
 	}
 
 	bool RUDPLink::areAllQueuesEmpty() const
 	{
 		std::unique_lock<std::mutex> lock(m_ReliableOrderedQueueMutex);
 		std::unique_lock<std::mutex> lock2(m_ReliableNewestQueueMutex);
-		std::unique_lock<std::mutex> lock3(m_RecvQueuesMutex);
-		std::unique_lock<std::mutex> lock4(m_AckMutex);
-		for ( i32_t i=0; i<sm_NumChannels; ++i )
+		std::unique_lock<std::mutex> lock3(m_AckMutex);
+		for ( i32_t i=0; i<sm_NumStreams; ++i )
 		{
-			if ( !m_RetransmitQueue_reliable[i].empty() ) return false;
-			if ( !m_RecvQueue_unreliable_sequenced[i].empty() ) return false;
-			if ( !m_RecvQueue_reliable_order[i].empty() ) return false;
+			if ( m_RetransmitBase_reliable[i] != m_RetransmitNext_reliable[i] ) return false;
+			if ( !m_SendBacklog_reliable[i].empty() ) return false;
 			if ( !m_AckQueue[i].empty() ) return false;
+			if ( m_SackDirty[i] ) return false;
 		}
 		if ( !m_SendQueue_reliable_newest.empty() ) return false;
-		if ( !m_RecvQueue_reliable_newest.empty() ) return false;
+		if ( m_NumReorderPackets != 0 ) return false;
+		if ( !m_RecvRing_reliable_order.empty() ) return false;
+		if ( !m_RecvRing_unreliable_sequenced.empty() ) return false;
+		if ( !m_RecvRing_reliable_newest.empty() ) return false;
 		return true;
 	}
 
-	bool RUDPLink::isSequenceDelivered(u32_t sequence, i8_t channel) const
+	bool RUDPLink::isSequenceDelivered(u32_t sequence, i32_t channel) const
 	{
 		std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
-		auto& queue = m_RetransmitQueue_reliable[channel];
-		auto it = std::find_if(queue.begin(), queue.end(), [&](auto& pack)
-		{
-			return *(u32_t*)&pack.data[off_Norm_Seq] == sequence;
-		});
-		bool bDelivered = it == queue.end();
+		// if not yet in flight (still in backlog) it cannot be delivered
+		if ( isSequenceNewer( sequence, m_RetransmitNext_reliable[channel] ) )
+			return false;
+		const reliableOrderedItem* item = getRetransmitSlot( channel, sequence );
+		bool bDelivered = !item || !item->inFlight || item->seq != sequence;
 		//if ( bDelivered )
 		//{
 		//	Platform::log("Delivered seq: %d chan: %d\n", sequence, channel);
@@ -253,13 +459,37 @@ namespace Zerodelay
 		return Util::getTimeSince(m_MarkDeleteTS);
 	}
 
+	void RUDPLink::getQueuedSend(i32_t channel, u32_t& bytesOut, u32_t& messagesOut) const
+	{
+		std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
+		if ( channel >= 0 && channel < sm_NumChannels )
+		{
+			bytesOut = m_QueuedBytes[channel];
+			messagesOut = m_QueuedMessages[channel];
+			return;
+		}
+		bytesOut = m_QueuedBytes_reliable_newest;
+		messagesOut = 0;
+		for (i32_t i=0; i<sm_NumChannels; ++i)
+		{
+			bytesOut += m_QueuedBytes[i];
+			messagesOut += m_QueuedMessages[i];
+		}
+	}
+
 	void RUDPLink::markPendingDelete()
 	{
 		std::lock_guard<std::mutex> lock(m_PendingDeleteMutex);
 		if ( m_IsPendingDelete )
 			return;
 		m_IsPendingDelete = true; 
-		m_MarkDeleteTS = ::clock();
+		m_MarkDeleteTS = Util::timeNow();
+	}
+
+	void RUDPLink::flush(ISocket* socket)
+	{
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		sendCoalescedPackets( socket );
 	}
 
 	void RUDPLink::pin()
@@ -284,31 +514,199 @@ namespace Zerodelay
 
 	// ----------------- Called from send thread -----------------------------------------------
 
-	void RUDPLink::dispatchRelOrderedQueueIfLatencyTimePassed(u32_t deltaTime, ISocket* socket)
+	i32_t RUDPLink::getTimeUntilNextSend() const
+	{
+		std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
+		i32_t tNow = Util::timeNow();
+		i32_t timeUntilSend = -1;
+		// earliest retransmission
+		if ( !m_RetransmitTimers.empty() )
+		{
+			auto first = m_RetransmitTimers.begin();
+			i32_t timeUntilDue = getTimeUntilRetransmit( first, tNow );
+			if ( timeUntilDue <= 0 ) timeUntilDue = getTimeUntilCanSend( first->second->pack.len, tNow );
+			if ( timeUntilDue < 0 )
+			{
+				// window is full, timers that expired since the dispatch make room right away
+				for ( auto it = first; it != m_RetransmitTimers.end() && getTimeUntilRetransmit( it, tNow ) <= 0; ++it )
+				{
+					if ( it->second->countedInFlight ) { timeUntilDue = 0; break; }
+				}
+			}
+			if ( timeUntilDue < 0 )
+			{
+				// otherwise an ack (wakes up the send thread) or the next timer that expires makes room
+				auto next = m_RetransmitTimers.upper_bound( getRetransmitKey( tNow ) );
+				if ( next != m_RetransmitTimers.end() ) timeUntilDue = getTimeUntilRetransmit( next, tNow );
+			}
+			if ( timeUntilDue >= 0 ) timeUntilSend = timeUntilDue;
+		}
+		// new data waiting for pacer (if waiting for window, an incoming ack wakes up the send thread)
+		for (i32_t chn=0; chn<sm_NumStreams; ++chn)
+		{
+			auto& backlog = m_SendBacklog_reliable[chn];
+			if ( backlog.empty() || (m_RetransmitNext_reliable[chn] - m_RetransmitBase_reliable[chn]) >= m_ReliableWindow )
+				continue;
+			i32_t timeUntilCanSend = getTimeUntilCanSend( backlog.front().len, tNow );
+			if ( timeUntilCanSend >= 0 && (timeUntilSend < 0 || timeUntilCanSend < timeUntilSend) )
+				timeUntilSend = timeUntilCanSend;
+		}
+		// coalesced packets waiting for their deadline
+		i32_t timeUntilFlush = getTimeUntilCoalesceDeadline();
+		if ( timeUntilFlush >= 0 && (timeUntilSend < 0 || timeUntilFlush < timeUntilSend) )
+			timeUntilSend = timeUntilFlush;
+		return timeUntilSend;
+	}
+
+	i32_t RUDPLink::getTimeUntilCanSend(u32_t numBytes, i32_t timeNow) const
+	{
+		if ( !m_CongestionControl )
+			return 0;
+		// always allow a single packet in flight, otherwise a packet bigger than the window could never be sent
+		if ( m_BytesInFlight > 0 && m_BytesInFlight + numBytes > m_CongestionControl->getWindow() )
+			return -1;
+		return m_Pacer.getTimeUntilAvailable( numBytes, timeNow );
+	}
+
+	bool RUDPLink::trySendReliable(u32_t numBytes, i32_t timeNow)
+	{
+		if ( !m_CongestionControl )
+			return true;
+		u32_t window = m_CongestionControl->getWindow();
+		if ( m_BytesInFlight > 0 && m_BytesInFlight + numBytes > window )
+			return false;
+		m_Pacer.setRate( window, getLatency() );
+		return m_Pacer.consume( numBytes, timeNow );
+	}
+
+	bool RUDPLink::hasSendBudget(u8_t channel, i32_t len) const
+	{
+		u32_t linkBytes = m_QueuedBytes_reliable_newest;
+		u32_t linkMessages = 0;
+		for (i32_t i=0; i<sm_NumChannels; ++i)
+		{
+			linkBytes += m_QueuedBytes[i];
+			linkMessages += m_QueuedMessages[i];
+		}
+		// a message larger than the budget still goes when nothing is queued, otherwise it could never be sent
+		auto fits = [len](u32_t bytes, u32_t messages, u32_t maxBytes, u32_t maxMessages)
+		{
+			if ( messages == 0 ) return true;
+			return (maxBytes == 0 || bytes + len <= maxBytes) && (maxMessages == 0 || messages < maxMessages);
+		};
+		return fits( linkBytes, linkMessages, m_SendBudgetBytes[0], m_SendBudgetMessages[0] ) &&
+			   fits( m_QueuedBytes[channel], m_QueuedMessages[channel], m_SendBudgetBytes[channel+1], m_SendBudgetMessages[channel+1] );
+	}
+
+	void RUDPLink::flushReliableBacklog(ISocket* socket)
 	{
-		m_RetransmitWaitingTime += deltaTime;
-		u32_t latencyTime = (u32_t)( 1.3f*getLatency() );
-		if ( m_RetransmitWaitingTime >= latencyTime )
+		i32_t tNow = Util::timeNow();
+		i32_t rto  = getRetransmitTimeout();
+		m_HasReliableBacklog = true; // until proven otherwise
+		for (i32_t chn=0; chn<sm_NumStreams; ++chn)
 		{
-			m_RetransmitWaitingTime -= latencyTime;
-			dispatchReliableOrderedQueue(socket);
+			auto& backlog = m_SendBacklog_reliable[chn];
+			if ( backlog.empty() )
+				continue;
+			auto& ring = m_RetransmitRing_reliable[chn];
+			if ( ring.empty() )
+			{
+				ring.resize( m_ReliableWindow );
+				for (auto& item : ring) item.inFlight = false;
+			}
+			u32_t& next = m_RetransmitNext_reliable[chn];
+			while ( !backlog.empty() && (next - m_RetransmitBase_reliable[chn]) < m_ReliableWindow )
+			{
+				if ( !trySendReliable( backlog.front().len, tNow ) )
+					return; // congestion window full or pacer has no tokens
+				reliableOrderedItem& item = ring[ next & (m_ReliableWindow-1) ];
+				assert( !item.inFlight );
+				item.pack = backlog.front();
+				item.seq  = next++;
+				item.inFlight = true;
+				item.countedInFlight = true;
+				item.lastSendTS = tNow;
+				item.rto = rto;
+				item.numTransmits = 1;
+				m_BytesInFlight += item.pack.len;
+				setRetransmitTimer( item, tNow + rto );
+				backlog.pop_front();
+				sendPacket( socket, item.pack );
+			}
+			if ( !backlog.empty() )
+				return;
 		}
+		m_HasReliableBacklog = false;
 	}
 
 	void RUDPLink::dispatchReliableOrderedQueue(ISocket* socket)
 	{
 		std::unique_lock<std::mutex> lock(m_ReliableOrderedQueueMutex);
-		for (auto& queue : m_RetransmitQueue_reliable)
+		i32_t tNow = Util::timeNow();
+		// timers are ordered by due time, so stop at first one that is not yet due
+		// first consider all timed out fragments lost so that they no longer occupy the congestion window
+		for ( auto it = m_RetransmitTimers.begin(); it != m_RetransmitTimers.end() && getTimeUntilRetransmit( it, tNow ) <= 0; ++it )
+		{
+			reliableOrderedItem* item = it->second;
+			if ( item->countedInFlight )
+			{
+				item->countedInFlight = false;
+				m_BytesInFlight -= item->pack.len;
+				if ( m_CongestionControl ) m_CongestionControl->onLoss( getLatency(), tNow, true );
+			}
+		}
+		// then resend them in order of expiry as far as the window allows
+		while ( hasRetransmitDue( tNow ) )
+		{
+			reliableOrderedItem* item = m_RetransmitTimers.begin()->second;
+			if ( !trySendReliable( item->pack.len, tNow ) )
+				break; // try again when acks arrive or pacer has tokens
+			m_RetransmitTimers.erase( m_RetransmitTimers.begin() );
+			// reliable pack.data is deleted when it gets acked
+			sendPacket( socket, item->pack );
+			item->countedInFlight = true;
+			m_BytesInFlight += item->pack.len;
+			item->lastSendTS = tNow;
+			item->numTransmits++;
+			item->rto = Util::min( sm_MaxRtoMs, item->rto*2 ); // exponential backoff
+			setRetransmitTimer( *item, tNow + item->rto );
+			// path may no longer carry datagrams of this size, continue with base size and search again from there
+			if ( item->numTransmits >= sm_MtuBlackHoleTransmits && item->pack.len > sm_MtuBaseSize && m_MtuSize > sm_MtuBaseSize )
+			{
+				Platform::log("WARNING: Datagrams of %d bytes to %s seem to be dropped, falling back to %d bytes.", 
+							  item->pack.len, m_EndPoint.toIpAndPort().c_str(), sm_MtuBaseSize);
+				m_MtuSearchHigh = Util::min( m_MtuSearchHigh, (i32_t)item->pack.len );
+				m_MtuProbeSize = 0;
+				m_MtuSearchDoneTS = 0;
+				setMaxDatagramSize( sm_MtuBaseSize );
+			}
+		}
+		// new data after retransmissions, acks may have made room in window
+		flushReliableBacklog(socket);
+	}
+
+	void RUDPLink::setRetransmitTimer(reliableOrderedItem& item, i32_t dueTS)
+	{
+		if ( m_RetransmitTimers.empty() )
+		{
+			m_RetransmitTimerBase = dueTS;
+		}
+		else if ( getRetransmitKey( dueTS ) > sm_RetransmitRebaseMs )
 		{
-			for (auto& pack : queue)
+			// timers never ran empty for a very long time, rekey them relative to the earliest
+			i32_t shift = m_RetransmitTimers.begin()->first;
+			retransmitTimerMap timers;
+			for ( auto& timer : m_RetransmitTimers )
 			{
-				// reliable pack.data is deleted when it gets acked
-				socket->send(m_EndPoint, pack.data, pack.len);
+				timer.second->timer = timers.insert( timers.end(), std::make_pair( timer.first - shift, timer.second ) );
 			}
+			m_RetransmitTimers.swap( timers );
+			m_RetransmitTimerBase = (i32_t)((u32_t)m_RetransmitTimerBase + (u32_t)shift);
 		}
+		item.timer = m_RetransmitTimers.insert( std::make_pair( getRetransmitKey( dueTS ), &item ) );
 	}
 
-	void RUDPLink::dispatchReliableNewestQueue(ISocket* socket)
+	bool RUDPLink::dispatchReliableNewestQueue(ISocket* socket)
 	{
 		// format per entry: groupId(4bytes) | groupBits( (items.size()+7)/8 bytes ) | n x groupData (sum( item_data_size, n ) bytes )
 		i8_t dataBuffer[ZERODELAY_BUFF_RECV_SIZE]; // recv buffer size correct!
@@ -337,7 +735,7 @@ namespace Zerodelay
 			for (auto& it : kvp.second.groupItems)
 			{
 				reliableNewestItem& item = it;
-				if (isSequenceNewer(item.localRevision, item.remoteRevision)) // variable is changed compared to last acked revision
+				if (item.localRevision != item.remoteRevision && isSequenceNewer(item.localRevision, item.remoteRevision)) // variable is changed compared to last acked revision
 				{
 					groupBits |= (1 << kBit);
 					assert(kBytesWritten + item.dataLen <= ZERODELAY_BUFF_SIZE); 
@@ -345,7 +743,7 @@ namespace Zerodelay
 					{
 						Platform::log("CRITICAL: Buffer overrun detected in %s.", ZERODELAY_FUNCTION_LINE );
 						m_RecvNode->getCoreNode()->setCriticalError( ECriticalError::TooMuchDataToSend, ZERODELAY_FUNCTION_LINE );
-						return;
+						return false;
 					}
 					Platform::memCpy(dataBuffer + kBytesWritten, item.dataLen, item.data, item.dataLen);
 					kBytesWritten += item.dataLen;
@@ -376,12 +774,24 @@ namespace Zerodelay
 			socket->send( m_EndPoint, dataBuffer, kBytesWritten );
 			m_SendSeq_reliable_newest++; // increment on each transmission
 		}
+		// groups are removed once acked
+		return !m_SendQueue_reliable_newest.empty();
+	}
+
+	void RUDPLink::dispatchAcks(ISocket* socket)
+	{
+		// acks that become pending from now on schedule a new dispatch
+		m_AcksScheduled = false;
+		dispatchSelectiveAckQueue(socket);
+		dispatchAckQueue(socket);
+		dispatchRelNewestAckQueue(socket);
+		dispatchRedundantAckQueue(socket);
 	}
 
 	void RUDPLink::dispatchAckQueue(ISocket* socket)
 	{
 		std::lock_guard<std::mutex> lock(m_AckMutex);
-		for(u32_t i=0; i<sm_NumChannels; i++)
+		for(u32_t i=0; i<sm_NumStreams; i++)
 		{
 			auto& ackQueue = m_AckQueue[i];
 			i8_t buff[ZERODELAY_BUFF_RECV_SIZE]; // recv buff size correct
@@ -391,7 +801,7 @@ namespace Zerodelay
 				u32_t seq = it;
 				*(u32_t*)&buff[kSizeWritten + off_Ack_Payload] = seq;
 				kSizeWritten += 4;
-				if (kSizeWritten >= ZERODELAY_BUFF_SIZE) // send when send buff size is exceeded
+				if (kSizeWritten + off_Ack_Payload + 4 > getMaxDatagramSize()) // send when datagram is full
 					break;
 			}
 			ackQueue.clear();
@@ -399,16 +809,47 @@ namespace Zerodelay
 			{
 				*(u32_t*)buff = m_LinkId;
 				buff[off_Type] = (i8_t)EHeaderPacketType::Ack;
-				buff[off_Ack_Chan] = (i8_t)i; // channel
+				buff[off_Ack_Chan] = (i8_t)i; // stream
 				*(u32_t*)&buff[off_Ack_Num] = kSizeWritten / 4; // num of acks
 				socket->send(m_EndPoint, buff, kSizeWritten + off_Ack_Payload); // <-- this is correct, ack_seq is payload offset (if no dataId attached)
 			}
 		}
 	}
 
+	void RUDPLink::dispatchSelectiveAckQueue(ISocket* socket)
+	{
+		// if acks were piggybacked on data since last call, nothing is pending
+		if ( !m_SackPending )
+			return;
+		i8_t buff[ZERODELAY_BUFF_RECV_SIZE];
+		i32_t kHdrSize;
+		if ( m_CompactHdr )
+		{
+			serializeCompactLinkId( buff, m_LinkId );
+			buff[off_Cmp_Type] = (i8_t)EHeaderPacketType::Ack_Selective;
+			kHdrSize = hdr_Cmp_Generic_Size;
+		}
+		else
+		{
+			*(u32_t*)buff = m_LinkId;
+			buff[off_Type] = (i8_t)EHeaderPacketType::Ack_Selective;
+			kHdrSize = hdr_Generic_Size;
+		}
+		// blocks pushed out of the window may not all fit in a single datagram
+		i32_t maxSize = Util::min( ZERODELAY_BUFF_RECV_SIZE, getMaxDatagramSize() );
+		while ( m_SackPending )
+		{
+			i32_t kSizeWritten = writeSelectiveAcks( buff + kHdrSize, maxSize - kHdrSize );
+			if ( kSizeWritten == 0 )
+				break;
+			socket->send(m_EndPoint, buff, kSizeWritten + kHdrSize);
+		}
+	}
+
 	void RUDPLink::dispatchRelNewestAckQueue(ISocket* socket)
 	{
 		if ( /*isPendingDelete() ||*/ !isConnected() ) return;
+		if ( !m_RelNewestAckPending.exchange( false ) ) return;
 		//BinSerializer bs;
 		//__CHECKEDR( bs.write((i8_t)EHeaderPacketType::Ack_Reliable_Newest) );
 		//__CHECKEDR( bs.write(m_LinkId) );
@@ -421,246 +862,1274 @@ namespace Zerodelay
 		socket->send(m_EndPoint, buff, hdr_Ack_RelNew_Size+hdr_Generic_Size);
 	}
 
-
-	// ----------------- Called from receive thread -----------------------------------------------
-
-	void RUDPLink::recvData(const i8_t* buff, i32_t rawSize)
+	i32_t RUDPLink::dispatchMtuProbe(ISocket* socket)
 	{
-		if ( m_PacketLossPercentage > 0 && (u8_t)(rand() % 100) < m_PacketLossPercentage )
-			return; // discard
-
-		u32_t linkId; 
-		EHeaderPacketType type;
-		if (!deserializeGenericHdr(buff, rawSize, linkId, type))
-			return;
-
-		switch ( type )
+		if ( isPendingDelete() ) return -1;
+		if ( !isConnected() ) return getRetransmitTimeout(); // look again later
+		i32_t tNow = Util::timeNow();
+		i32_t ackSize = m_MtuProbeAckSize.exchange( 0 );
+		if ( ackSize > m_MtuSize && ackSize < m_MtuSearchHigh )
 		{
-		case EHeaderPacketType::Ack:
-			receiveAck( buff, rawSize );
-			break;
-
-		case EHeaderPacketType::Ack_Reliable_Newest:
-			receiveAckRelNewest( buff, rawSize );
-			break;
-
-		case EHeaderPacketType::Reliable_Ordered:
-			// ack it (even if we already processed this packet)
-			addAckToAckQueue( buff[off_Norm_ChanNFlags] & 7, *(u32_t*)&buff[off_Norm_Seq] );
-			receiveReliableOrdered( linkId, buff, rawSize );	
-			break;
-
-		case EHeaderPacketType::Unreliable_Sequenced:
-			receiveUnreliableSequenced( linkId, buff, rawSize );
-			break;
+			setMaxDatagramSize( ackSize );
+			if ( ackSize >= m_MtuProbeSize ) m_MtuProbeSize = 0;
+		}
+		if ( m_MtuProbeSize != 0 )
+		{
+			i32_t timeUntilLost = getRetransmitTimeout() - Util::getTimeSince( m_MtuProbeTS );
+			if ( timeUntilLost > 0 )
+				return timeUntilLost; // wait for ack
+			if ( m_MtuProbeCount >= sm_MtuMaxProbes )
+			{
+				m_MtuSearchHigh = m_MtuProbeSize;
+				m_MtuProbeSize  = 0;
+			}
+		}
+		if ( m_MtuProbeSize == 0 )
+		{
+			if ( m_MtuSearchHigh - m_MtuSize <= sm_MtuSearchGranularity )
+			{
+				// search done, try again later in case a bigger size is possible now
+				if ( m_MtuSearchDoneTS == 0 ) m_MtuSearchDoneTS = tNow;
+				i32_t timeUntilRaise = sm_MtuRaiseIntervalMs - Util::getTimeSince( m_MtuSearchDoneTS );
+				if ( timeUntilRaise > 0 )
+					return timeUntilRaise;
+				m_MtuSearchHigh = sm_MtuMaxSize+1;
+				m_MtuSearchDoneTS = 0;
+			}
+			if ( m_MtuSize < sm_MtuEthernetSize && sm_MtuEthernetSize < m_MtuSearchHigh )
+				m_MtuProbeSize = sm_MtuEthernetSize;
+			else
+				m_MtuProbeSize = (m_MtuSize + m_MtuSearchHigh) / 2; // binary search
+			m_MtuProbeCount = 0;
+		}
+		// padded to the size that is probed, not coalesced nor piggybacked
+		i8_t buff[sm_MtuMaxSize];
+		std::memset( buff, 0, m_MtuProbeSize );
+		*(u32_t*)buff = m_LinkId;
+		buff[off_Type] = (i8_t)EHeaderPacketType::Mtu_Probe;
+		*(u16_t*)(buff + off_Mtu_Size) = (u16_t)m_MtuProbeSize;
+		socket->send( m_EndPoint, buff, m_MtuProbeSize );
+		m_MtuProbeCount++;
+		m_MtuProbeTS = tNow;
+		return getRetransmitTimeout();
+	}
 
-		case EHeaderPacketType::Reliable_Newest:
-			receiveReliableNewest( linkId, buff, rawSize );
-			break;
+	void RUDPLink::setMaxDatagramSize(i32_t size)
+	{
+		m_MtuSize = size;
+		m_FragmentSize = size - off_Norm_Data;
+	}
 
-		default:
-			Platform::log("WARNING: Unknown HeaderPacketType received. Packet dropped.");
-			break;
-		}
+	void RUDPLink::writeSequence(Packet& pack, u32_t seq) const
+	{
+		if ( isCompactHeader( pack.data ) ) *(u16_t*)&pack.data[off_Cmp_Norm_Seq] = (u16_t)seq;
+		else *(u32_t*)&pack.data[off_Norm_Seq] = seq;
 	}
 
-	void RUDPLink::addAckToAckQueue(i8_t channel, u32_t seq)
+	void RUDPLink::linkSubStream(Packet& firstFragment, i32_t stream, u8_t channel, u32_t subStream, u32_t firstSeq, u32_t lastSeq)
 	{
-		std::lock_guard<std::mutex> lock(m_AckMutex);
-		auto it = std::find( m_AckQueue[channel].begin(), m_AckQueue[channel].end(), seq );
-		if ( it == m_AckQueue[channel].end() )
+		// If the previous message of the sub-stream is acked, so is everything before it. The receiver then has delivered
+		// the whole sub-stream so far and can deliver this message as soon as it is complete.
+		auto& lastSeqs = m_SubStreamLastSeq[channel];
+		u32_t base = m_RetransmitBase_reliable[stream];
+		auto it = lastSeqs.find( subStream );
+		if ( it != lastSeqs.end() && isSequenceNewer( it->second, base ) )
+		{
+			*(u32_t*)&firstFragment.data[off_Norm_Data + off_Sub_Dist] = firstSeq - it->second;
+		}
+		lastSeqs[subStream] = lastSeq;
+		// forget sub-streams without unacked messages, amortized over the sends
+		if ( lastSeqs.size() > m_SubStreamPruneSize[channel] )
 		{
-			m_AckQueue[channel].emplace_back( seq );
+			for ( it = lastSeqs.begin(); it != lastSeqs.end(); )
+			{
+				if ( !isSequenceNewer( it->second, base ) ) it = lastSeqs.erase( it );
+				else ++it;
+			}
+			m_SubStreamPruneSize[channel] = Util::max( sm_SubStreamMinPruneSize, (u32_t)lastSeqs.size()*2 );
 		}
 	}
 
-	void RUDPLink::receiveReliableOrdered(u32_t linkId, const i8_t * buff, i32_t rawSize)
+	bool RUDPLink::isCompactLinkId(const i8_t* buff) const
 	{
-		i8_t channel;
-		bool relay;
-		u32_t seq;
-		bool firstFragment, lastFragment;
-		if ( !deserializeNormalHdr(buff, rawSize, channel, relay, seq, firstFragment, lastFragment) )
+		i8_t shortId[2];
+		serializeCompactLinkId( shortId, m_LinkId );
+		return (u8_t)(buff[0] & ~sm_CompactPiggyAckBit) == (u8_t)shortId[0] && buff[1] == shortId[1];
+	}
+
+
+	// ----------------- Called from main or send thread -----------------------------------------------
+
+	void RUDPLink::sendDatagram(ISocket* socket, const i8_t* data, i32_t len, const i8_t* payload, i32_t payloadLen)
+	{
+		u32_t coalesceDelay = m_RecvNode->getCoalesceDelay();
+		// the first packet to an unknown link must be a plain connect request, so only coalesce once connected
+		if ( coalesceDelay == 0 || !m_Connected )
 		{
-			// Critical because packet is already acked while it cannot be reliably handled.
-			m_RecvNode->getCoreNode()->setCriticalError(ECriticalError::SerializationError, ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			flush( socket ); // keep order with previously coalesced packets
+			sendWithAcks( socket, data, len, payload, payloadLen );
 			return;
 		}
-
-		// early out if game thread already processed packet
-		if ( !isSequenceNewer(seq, m_RecvSeq_reliable[channel]) )
-			return;
-
-		auto& queue = m_RecvQueue_reliable_order[channel];
-		if ( firstFragment && lastFragment ) // not fragmented
+		bool bScheduleFlush = false;
 		{
-			// packet may arrive multiple time (if is not next expected sequence and cause game thread increments the sequence)
-			std::lock_guard<std::mutex> lock(m_RecvQueuesMutex);
-			if ( queue.count( seq ) == 0 )
+			std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+			// an aggregate has the same header format as its items
+			bool bCompact = isCompactHeader( data );
+			i32_t kTypeOffset = bCompact ? off_Cmp_Type : off_Type;
+			i32_t kAggDataOffset = bCompact ? off_Cmp_Agg_Data : off_Agg_Data;
+			i32_t maxSize  = getMaxDatagramSize();
+			i32_t itemSize = hdr_Agg_Item_Size + (len + payloadLen - kTypeOffset);
+			if ( m_CoalesceCount > 0 && (m_CoalesceLen + itemSize > maxSize || m_CoalesceCompact != bCompact) )
 			{
-				Packet pack; // Offset off_Norm_Id is correct data packet type (EDataPacketType) (not EHeaderPacketType!) is included in the data
-				createNormalPacket( pack, buff + off_Norm_Id, rawSize-off_Norm_Id, linkId, channel, relay, EHeaderPacketType::Reliable_Ordered );
-				queue.insert( std::make_pair(seq, std::make_pair(pack, 1)) );
+				sendCoalescedPackets( socket );
 			}
-		}
-		else // fragmented
-		{
-			auto& fragments = m_Reliable_fragments[channel];
-			if ( fragments.count( seq ) == 0 ) // pack may arrive multiple times (game thread increments the sequence)
+			if ( kAggDataOffset + itemSize > maxSize ) // does not fit in an aggregate at all
 			{
-				Packet pack; // Offset off_Norm_Id is correct data packet type (EDataPacketType) (not EHeaderPacketType!) is included in the data
-				createNormalPacket( pack, buff + off_Norm_Id, rawSize-off_Norm_Id, linkId, channel, relay, EHeaderPacketType::Reliable_Ordered );
-				if ( firstFragment ) pack.flags |= (FirstFragmentBit);
-				if ( lastFragment )  pack.flags |= (LastFragmentBit);
-				fragments.insert( std::make_pair(seq, pack) );
-
-				// find possible start of a range of fragments
-				Packet finalPack;
-				u32_t seqBegin, seqEnd;
-				if (tryReassembleBigPacket(finalPack, fragments, seq, seqBegin, seqEnd))
+				sendWithAcks( socket, data, len, payload, payloadLen );
+				return;
+			}
+			if ( m_CoalesceCount == 0 )
+			{
+				if ( bCompact )
+				{
+					serializeCompactLinkId( m_CoalesceBuffer, m_LinkId );
+					m_CoalesceBuffer[off_Cmp_Type] = (i8_t)EHeaderPacketType::Aggregate;
+				}
+				else
 				{
-					std::lock_guard<std::mutex> lock(m_RecvQueuesMutex);
-					queue.insert( std::make_pair(seqBegin, std::make_pair(finalPack, 1+(seqEnd-seqBegin))) );
+					*(u32_t*)m_CoalesceBuffer = m_LinkId;
+					m_CoalesceBuffer[off_Type] = (i8_t)EHeaderPacketType::Aggregate;
 				}
+				m_CoalesceLen = kAggDataOffset;
+				m_CoalesceCompact = bCompact;
+				// in low latency only what is added until the send thread gets to it goes along
+				if ( m_RecvNode->isLowLatency() ) coalesceDelay = 0;
+				m_CoalesceDeadlineTS = Util::timeNow() + coalesceDelay;
+				bScheduleFlush = true; // so that the send thread flushes at deadline
 			}
+			i8_t* item = m_CoalesceBuffer + m_CoalesceLen + hdr_Agg_Item_Size;
+			*(u16_t*)(m_CoalesceBuffer + m_CoalesceLen) = (u16_t)(itemSize - hdr_Agg_Item_Size);
+			Platform::memCpy( item, maxSize - m_CoalesceLen - hdr_Agg_Item_Size, data + kTypeOffset, len - kTypeOffset );
+			if ( payloadLen > 0 ) Platform::memCpy( item + len - kTypeOffset, maxSize - m_CoalesceLen - hdr_Agg_Item_Size - (len - kTypeOffset), payload, payloadLen );
+			m_CoalesceLen += itemSize;
+			m_CoalesceCount++;
+		}
+		if ( bScheduleFlush )
+		{
+			m_RecvNode->scheduleLink( this, ELinkTimer::Send, coalesceDelay );
 		}
 	}
 
-	void RUDPLink::receiveUnreliableSequenced(u32_t linkId, const i8_t * buff, i32_t rawSize)
+	void RUDPLink::sendCoalescedPackets(ISocket* socket)
 	{
-		i8_t channel;
-		bool relay;
-		u32_t seq;
-		bool firstFragment, lastFragment;
-		if ( !deserializeNormalHdr(buff, rawSize, channel, relay, seq, firstFragment, lastFragment) )
-		{
-			Platform::log("WARNING: Serialization error in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE );
+		if ( m_CoalesceCount == 0 )
 			return;
-		}
-
-	//	Platform::log("Incoming unreliable seq: %d, chan %d.",  seq, channel);
-		
-		// drop out of sequence (older) packets
-		auto& recvSeq = m_RecvSeq_unreliable[channel];
-		if ( !isSequenceNewer(seq, recvSeq) )
+		if ( m_CoalesceCount == 1 )
 		{
-		//	Platform::log("But dropped seq: %d not newer than: %d, chan %d.",  seq, recvSeq, channel);
-			return;
-		}
-
-		Packet pack; 
-		if ( firstFragment && lastFragment )
-		{ // not fragmented
-			recvSeq = seq+1;
-			createNormalPacket( pack, buff + off_Norm_Id, rawSize-off_Norm_Id, linkId, channel, relay, EHeaderPacketType::Unreliable_Sequenced );
-			std::lock_guard<std::mutex> lock(m_RecvQueuesMutex);
-			m_RecvQueue_unreliable_sequenced[channel].emplace_back( pack );
+			// single packet, send in original form by putting linkId in front of its type byte
+			i32_t kTypeOffset = m_CoalesceCompact ? off_Cmp_Type : off_Type;
+			i32_t kAggDataOffset = m_CoalesceCompact ? off_Cmp_Agg_Data : off_Agg_Data;
+			i8_t* packet = m_CoalesceBuffer + kAggDataOffset + hdr_Agg_Item_Size - kTypeOffset;
+			i32_t packetLen = *(u16_t*)(m_CoalesceBuffer + kAggDataOffset) + kTypeOffset;
+			if ( m_CoalesceCompact ) serializeCompactLinkId( packet, m_LinkId );
+			else *(u32_t*)packet = m_LinkId;
+			sendWithAcks( socket, packet, packetLen );
 		}
 		else
-		{ // unreliable fragmented packet
-			auto& fragmentBuffer = m_Ureliable_fragments[channel];
-			if ( fragmentBuffer.count(seq) == 0)
-			{
-				createNormalPacket( pack, buff + off_Norm_Id, rawSize-off_Norm_Id, linkId, channel, relay, EHeaderPacketType::Unreliable_Sequenced );
-				if ( firstFragment ) pack.flags |= (FirstFragmentBit);
-				if ( lastFragment )  pack.flags |= (LastFragmentBit);
-				fragmentBuffer.insert(std::make_pair(seq, pack));
-
-				Packet finalPack;
-				u32_t beginSeq, lastSeq;
-				if (tryReassembleBigPacket(finalPack, fragmentBuffer, seq, beginSeq, lastSeq))
-				{
-				//	Platform::log("Unreliable Reassmbled firstSeq: %d, lastSeq %d, chan %d, numFragments %d.", beginSeq, lastSeq, channel, 1+(lastSeq-beginSeq));
-
-					// push new reassembled packet to queue for processing
-					{
-						std::lock_guard<std::mutex> lock(m_RecvQueuesMutex);
-						m_RecvQueue_unreliable_sequenced[channel].emplace_back( finalPack );
-					}
-					
-					recvSeq = lastSeq + 1;
-					// remove all buffered fragments (older) that can no longer be processed because a newer big packet was succesfully reassembled
-					for (auto it = fragmentBuffer.begin(); it != fragmentBuffer.end(); )
-					{
-						if (!isSequenceNewer(it->first, recvSeq))
-						{
-							delete [] it->second.data;
-							it = fragmentBuffer.erase(it);
-						}
-						else it++;
-					}
-				}
-			}
+		{
+			sendWithAcks( socket, m_CoalesceBuffer, m_CoalesceLen );
 		}
+		m_CoalesceCount = 0;
+		m_CoalesceLen = 0;
 	}
 
-	void RUDPLink::receiveReliableNewest(u32_t linkId, const i8_t* buff, i32_t rawSize)
+	void RUDPLink::dispatchCoalescedPackets(ISocket* socket)
 	{
-		if ( rawSize < hdr_Relnew_Size )
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		if ( m_CoalesceCount > 0 && (Util::timeNow() - m_CoalesceDeadlineTS) >= 0 )
 		{
-			Platform::log("WARNING: Invalid reliable newest data, too short. In %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
-			return;
+			sendCoalescedPackets( socket );
 		}
+	}
 
-		// If sequence is older than already received, discarda all info
-		u32_t seq = *(u32_t*)(buff + off_RelNew_Seq);
-		if ( !isSequenceNewer(seq, m_RecvSeq_reliable_newest) )
-			return;
-		
-		// from now on only interested in current sequence +1
-		m_RecvSeq_reliable_newest = seq+1;					
-
-		// do further processing of individual groups in higher level group unwrap system
-		Packet pack;
-		createNormalPacket( pack, buff + off_RelNew_Num, rawSize - off_RelNew_Num, linkId, 0, false, EHeaderPacketType::Reliable_Newest );
-
-		std::lock_guard<std::mutex> lock(m_RecvQueuesMutex);
-		m_RecvQueue_reliable_newest.emplace_back( pack );
+	i32_t RUDPLink::getTimeUntilCoalesceDeadline() const
+	{
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		if ( m_CoalesceCount == 0 )
+			return -1;
+		return Util::max( 0, m_CoalesceDeadlineTS - Util::timeNow() );
 	}
 
-	void RUDPLink::receiveAck(const i8_t * buff, i32_t rawSize)
+	void RUDPLink::sendWithAcks(ISocket* socket, const i8_t* data, i32_t len, const i8_t* payload, i32_t payloadLen)
 	{
-		if (rawSize < hdr_Ack_Size)
+		i8_t buff[ZERODELAY_BUFF_RECV_SIZE];
+		if ( m_SackPending )
 		{
-			Platform::log("WARNING: Invalid ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
-			return;
-		}
-		i8_t channel = buff[off_Ack_Chan];
+			assert( len + payloadLen <= ZERODELAY_BUFF_SIZE );
+			Platform::memCpy( buff, len, data, len );
+			if ( payloadLen > 0 ) Platform::memCpy( buff + len, payloadLen, payload, payloadLen );
+			data = buff;
+			len += payloadLen;
+			i32_t kSackSize = writeSelectiveAcks( buff + len, Util::min( ZERODELAY_BUFF_RECV_SIZE, getMaxDatagramSize() ) - len );
+			if ( kSackSize > 0 )
+			{
+				if ( isCompactHeader( buff ) ) buff[0] |= sm_CompactPiggyAckBit;
+				else buff[off_Type] |= sm_PiggyAckBit;
+				socket->send( m_EndPoint, buff, len + kSackSize );
+				return;
+			}
+			payloadLen = 0; // copied already
+		}
+		if ( payloadLen > 0 ) socket->sendGather( m_EndPoint, data, len, payload, payloadLen );
+		else socket->send( m_EndPoint, data, len );
+	}
+
+	i32_t RUDPLink::writeSelectiveAcks(i8_t* buff, i32_t buffSize)
+	{
+		std::lock_guard<std::mutex> lock(m_AckMutex);
+		i32_t kSizeWritten = 0;
+		u8_t  kNumBlocks = 0;
+		auto writeBlock = [&](i8_t stream, u32_t latest, u32_t mask)
+		{
+			if ( kSizeWritten + hdr_Sack_Size + 1 > buffSize || kNumBlocks == 255 ) return false;
+			buff[kSizeWritten + off_Sack_Chan] = stream;
+			*(u32_t*)(buff + kSizeWritten + off_Sack_Latest) = latest;
+			*(u32_t*)(buff + kSizeWritten + off_Sack_Mask)   = mask;
+			kSizeWritten += hdr_Sack_Size;
+			kNumBlocks++;
+			return true;
+		};
+		// pushed out blocks are older, send them first so that acks arrive in order
+		u32_t kNumQueued = 0;
+		while ( kNumQueued < m_SackQueue.size() && writeBlock( m_SackQueue[kNumQueued].stream, m_SackQueue[kNumQueued].latest, m_SackQueue[kNumQueued].mask ) )
+		{
+			kNumQueued++;
+		}
+		m_SackQueue.erase( m_SackQueue.begin(), m_SackQueue.begin() + kNumQueued );
+		for (i32_t i=0; i<sm_NumStreams; ++i)
+		{
+			if ( !m_SackDirty[i] ) continue;
+			if ( !writeBlock( (i8_t)i, m_SackLatest[i], m_SackMask[i] ) ) break;
+			m_SackDirty[i] = false;
+		}
+		if ( kNumBlocks == 0 )
+			return 0;
+		m_SackPending = !m_SackQueue.empty();
+		for (auto dirty : m_SackDirty) if ( dirty ) m_SackPending = true; // did not fit
+		buff[kSizeWritten++] = (i8_t)kNumBlocks;
+		return kSizeWritten;
+	}
+
+
+	// ----------------- Called from receive thread -----------------------------------------------
+
+	void RUDPLink::recvData(const i8_t* buff, i32_t rawSize)
+	{
+		m_RecvBuffer = buff;
+		if ( m_PacketLossPercentage > 0 && (u8_t)(rand() % 100) < m_PacketLossPercentage )
+			return; // discard
+
+		u32_t linkId; 
+		EHeaderPacketType type;
+		m_RecvCompact = isCompactHeader( buff );
+		if ( m_RecvCompact )
+		{
+			if ( rawSize < hdr_Cmp_Generic_Size )
+				return;
+			linkId = m_LinkId; // short link id was checked by RecvNode
+			type = deserializeCompactType( buff[off_Cmp_Type] );
+		}
+		else if (!deserializeGenericHdr(buff, rawSize, linkId, type))
+			return;
+
+		// strip piggybacked selective acks from end of datagram
+		if ( m_RecvCompact ? (buff[0] & sm_CompactPiggyAckBit) : (buff[off_Type] & sm_PiggyAckBit) )
+		{
+			i32_t kSackSize = (u8_t)buff[rawSize-1] * hdr_Sack_Size + 1;
+			if ( kSackSize > rawSize - (m_RecvCompact ? hdr_Cmp_Generic_Size : hdr_Generic_Size) )
+			{
+				Platform::log("WARNING: Invalid piggybacked ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+				return;
+			}
+			rawSize -= kSackSize;
+			receiveSelectiveAcks( buff + rawSize, kSackSize );
+		}
+
+		recvPacket( linkId, type, buff, rawSize );
+	}
+
+	void RUDPLink::receiveAggregate(u32_t linkId, const i8_t* buff, i32_t rawSize)
+	{
+		i32_t kTypeOffset = m_RecvCompact ? off_Cmp_Type : off_Type;
+		i32_t kOffset = m_RecvCompact ? off_Cmp_Agg_Data : off_Agg_Data;
+		while ( kOffset + hdr_Agg_Item_Size <= rawSize )
+		{
+			i32_t itemLen = *(u16_t*)(buff + kOffset);
+			kOffset += hdr_Agg_Item_Size;
+			if ( itemLen < 1 || kOffset + itemLen > rawSize )
+			{
+				Platform::log("WARNING: Invalid aggregate item size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+				return;
+			}
+			EHeaderPacketType type = m_RecvCompact ? deserializeCompactType( buff[kOffset] ) : (EHeaderPacketType)(u8_t)buff[kOffset];
+			if ( type == EHeaderPacketType::Aggregate )
+			{
+				Platform::log("WARNING: Nested aggregate packet dropped.");
+				return;
+			}
+			// Item starts at type byte, let ptr point to where linkId would have been so that all header offsets stay valid.
+			// The linkId bytes are not read again (belong to previous item), linkId is passed explicitly.
+			recvPacket( linkId, type, buff + kOffset - kTypeOffset, itemLen + kTypeOffset );
+			kOffset += itemLen;
+		}
+	}
+
+	void RUDPLink::recvPacket(u32_t linkId, EHeaderPacketType type, const i8_t* buff, i32_t rawSize)
+	{
+		if ( m_RecvCompact && type != EHeaderPacketType::Reliable_Ordered && type != EHeaderPacketType::Unreliable_Sequenced &&
+			 type != EHeaderPacketType::Ack_Selective && type != EHeaderPacketType::Aggregate )
+		{
+			Platform::log("WARNING: Unexpected HeaderPacketType %d in compact header. Packet dropped.", (i32_t)type);
+			return;
+		}
+		switch ( type )
+		{
+		case EHeaderPacketType::Aggregate:
+			receiveAggregate( linkId, buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Ack:
+			receiveAck( buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Ack_Reliable_Newest:
+			receiveAckRelNewest( buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Ack_Selective:
+			{
+				i32_t kHdrSize = m_RecvCompact ? hdr_Cmp_Generic_Size : hdr_Generic_Size;
+				receiveSelectiveAcks( buff + kHdrSize, rawSize - kHdrSize );
+			}
+			break;
+
+		case EHeaderPacketType::Reliable_Ordered:
+		case EHeaderPacketType::Reliable_Unordered:
+		case EHeaderPacketType::Reliable_SubStream:
+			receiveReliable( linkId, type, buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Unreliable_Sequenced:
+		case EHeaderPacketType::Unreliable:
+			receiveUnreliable( linkId, type, buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Reliable_Newest:
+			receiveReliableNewest( linkId, buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Fec_Parity:
+			receiveFecParity( linkId, buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Unreliable_Redundant:
+			receiveRedundant( linkId, buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Ack_Redundant:
+			receiveAckRedundant( buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Mtu_Probe:
+			receiveMtuProbe( buff, rawSize );
+			break;
+
+		case EHeaderPacketType::Mtu_Probe_Ack:
+			receiveMtuProbeAck( buff, rawSize );
+			break;
+
+		default:
+			Platform::log("WARNING: Unknown HeaderPacketType received. Packet dropped.");
+			break;
+		}
+	}
+
+	void RUDPLink::addAckToAckQueue(i32_t channel, u32_t seq)
+	{
+		std::lock_guard<std::mutex> lock(m_AckMutex);
+		// try to fit in selective ack window [latest-sm_SackMaskBits, latest]
+		u32_t& latest = m_SackLatest[channel];
+		u32_t& mask   = m_SackMask[channel];
+		if ( !m_SackValid[channel] )
+		{
+			latest = seq;
+			mask   = 0;
+			m_SackValid[channel] = true;
+		}
+		else if ( seq != latest && isSequenceNewer(seq, latest) )
+		{
+			u32_t shift = seq - latest; // previous latest ends up at bit shift-1
+			// acks that shift out of the window were not sent yet, keep the block for the send thread
+			if ( m_SackDirty[channel] && (shift >= sm_SackMaskBits || (mask >> (sm_SackMaskBits - shift)) != 0) )
+			{
+				m_SackQueue.push_back( { latest, mask, (i8_t)channel } );
+			}
+			mask   = (shift < sm_SackMaskBits ? (mask << shift) : 0);
+			mask  |= (shift <= sm_SackMaskBits ? (1U << (shift-1)) : 0);
+			latest = seq;
+		}
+		else if ( seq != latest )
+		{
+			u32_t back = latest - seq;
+			if ( back <= sm_SackMaskBits ) mask |= (1U << (back-1));
+			else
+			{
+				// too old for the window, ack explicitly
+				auto it = std::find( m_AckQueue[channel].begin(), m_AckQueue[channel].end(), seq );
+				if ( it == m_AckQueue[channel].end() )
+				{
+					m_AckQueue[channel].emplace_back( seq );
+				}
+				scheduleAcks();
+				return;
+			}
+		}
+		m_SackDirty[channel] = true;
+		m_SackPending = true;
+		// once queued, a dispatch that is already running could otherwise miss it
+		scheduleAcks();
+	}
+
+	void RUDPLink::scheduleAcks()
+	{
+		// the first pending ack starts the aggregate time, acks that follow go along
+		if ( !m_AcksScheduled.exchange( true ) )
+		{
+			// in low latency acks that arrive before the send thread wakes up still go together,
+			// and it sends data first so that acks are piggybacked on it when there is any
+			i32_t delay = m_RecvNode->isLowLatency() ? 0 : m_RecvNode->getAckAggregateTime();
+			m_RecvNode->scheduleLink( this, ELinkTimer::Ack, delay );
+		}
+	}
+
+	void RUDPLink::receiveReliable(u32_t linkId, EHeaderPacketType type, const i8_t * buff, i32_t rawSize)
+	{
+		i32_t channel;
+		bool relay;
+		u32_t seq;
+		bool firstFragment, lastFragment;
+		if ( !deserializeNormalHdr(buff, rawSize, m_RecvCompact, channel, relay, seq, firstFragment, lastFragment) )
+		{
+			// Critical because reliable data cannot be handled.
+			m_RecvNode->getCoreNode()->setCriticalError(ECriticalError::SerializationError, ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		i32_t stream = getStream( type, channel );
+		i32_t kIdOffset = off_Norm_Id;
+		if ( m_RecvCompact )
+		{
+			// sender keeps sequences within the window around the next to deliver
+			seq = expandSequence( seq, m_RecvSeq_reliable[stream] );
+			kIdOffset = off_Cmp_Norm_Id;
+		}
+
+		// early out if already delivered to game thread, ack again as the previous ack may have been lost
+		if ( !isSequenceNewer(seq, m_RecvSeq_reliable[stream]) )
+		{
+			addAckToAckQueue( stream, seq );
+			return;
+		}
+
+		// do not accept (and ack) beyond the reorder window, sender resends it when there is room
+		if ( seq - m_RecvSeq_reliable[stream] >= m_ReliableWindow )
+			return;
+
+		auto& ring = m_ReorderRing_reliable[stream];
+		if ( ring.empty() )
+		{
+			ring.resize( m_ReliableWindow );
+		}
+		recvFragmentSlot& slot = ring[ seq & (m_ReliableWindow-1) ];
+		// packet may arrive multiple times
+		if ( slot.filled )
+		{
+			addAckToAckQueue( stream, seq );
+			return;
+		}
+
+		// Everything in the reorder buffer plus this packet must fit in the ring once the gap before it is filled.
+		// If the game thread is not polling, do not accept (and ack) it, the sender resends it later.
+		if ( m_RecvRing_reliable_order.freeSpace() <= (u32_t)m_NumReorderPackets )
+			return;
+
+		// Offset of Id is correct data packet type (EDataPacketType) (not EHeaderPacketType!) is included in the data
+		createNormalPacket( slot.pack, m_RecvBuffer, buff + kIdOffset, rawSize-kIdOffset, linkId, channel, relay, type );
+		if ( firstFragment ) slot.pack.flags |= (FirstFragmentBit);
+		if ( lastFragment )  slot.pack.flags |= (LastFragmentBit);
+		slot.seq = seq;
+		slot.filled = true;
+		slot.delivered = false;
+		m_NumReorderPackets++;
+		if ( type != EHeaderPacketType::Reliable_Ordered )
+		{
+			deliverReliableUnordered( stream, seq );
+		}
+		deliverReliableOrdered( stream );
+		addAckToAckQueue( stream, seq );
+	}
+
+	void RUDPLink::deliverReliableOrdered(i32_t stream)
+	{
+		auto& ring = m_ReorderRing_reliable[stream];
+		auto& assembly = m_Assembly_reliable[stream];
+		u32_t& recvSeq = m_RecvSeq_reliable[stream];
+		for ( recvFragmentSlot* slot = &ring[ recvSeq & (m_ReliableWindow-1) ]; slot->filled; slot = &ring[ recvSeq & (m_ReliableWindow-1) ] )
+		{
+			Packet pack = slot->pack;
+			slot->filled = false;
+			recvSeq++;
+			if ( slot->delivered )
+				continue; // reliable unordered, was delivered on arrival
+			m_NumReorderPackets--;
+			// fragments arrive here in order, so a message is complete when its last fragment is reached
+			bool bFirst = (pack.flags & FirstFragmentBit) != 0;
+			bool bLast  = (pack.flags & LastFragmentBit) != 0;
+			if ( !(bFirst && bLast) )
+			{
+				if ( bFirst != assembly.empty() )
+				{
+					Platform::log("WARNING: Unexpected reliable fragment dropped in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+					PacketPool::release( pack.buffer );
+					continue;
+				}
+				assembly.emplace_back( pack );
+				if ( !bLast )
+					continue;
+				u32_t numFragments = (u32_t)assembly.size();
+				defragmentPacket( pack, assembly );
+				releaseReliable( stream, pack, recvSeq-numFragments, recvSeq-1 );
+				continue;
+			}
+			releaseReliable( stream, pack, recvSeq-1, recvSeq-1 );
+		}
+	}
+
+	void RUDPLink::deliverReliableUnordered(i32_t stream, u32_t seq)
+	{
+		// Deliver the message of this fragment if all its fragments are in the reorder ring, regardless of earlier messages.
+		// If its first fragments are before the next to deliver, they were moved to the assembly and the message completes there.
+		auto& ring = m_ReorderRing_reliable[stream];
+		u32_t mask = m_ReliableWindow-1;
+		auto isWaiting = [&](u32_t fragSeq)
+		{
+			const recvFragmentSlot& slot = ring[ fragSeq & mask ];
+			return slot.filled && !slot.delivered && slot.seq == fragSeq;
+		};
+		u32_t first = seq;
+		while ( !(ring[ first & mask ].pack.flags & FirstFragmentBit) )
+		{
+			if ( !isWaiting( first-1 ) ) return;
+			first--;
+		}
+		u32_t last = seq;
+		while ( !(ring[ last & mask ].pack.flags & LastFragmentBit) )
+		{
+			if ( !isWaiting( last+1 ) ) return;
+			last++;
+		}
+		Packet pack;
+		m_FragmentScratch.clear();
+		for (u32_t fragSeq = first; fragSeq != last+1; ++fragSeq) // take into account that seq wraps
+		{
+			recvFragmentSlot& slot = ring[ fragSeq & mask ];
+			m_FragmentScratch.emplace_back( slot.pack );
+			slot.delivered = true; // slot stays filled until next to deliver passes it, so that duplicates are recognized
+			m_NumReorderPackets--;
+		}
+		if ( first == last )
+		{
+			pack = m_FragmentScratch[0];
+		}
+		else
+		{
+			defragmentPacket( pack, m_FragmentScratch );
+		}
+		releaseReliable( stream, pack, first, last );
+	}
+
+	void RUDPLink::releaseReliable(i32_t stream, Packet& pack, u32_t firstSeq, u32_t lastSeq)
+	{
+		pack.flags &= ~(FirstFragmentBit | LastFragmentBit);
+		if ( pack.type == EHeaderPacketType::Reliable_SubStream )
+		{
+			if ( pack.len < 1 + hdr_Sub_Size ) // id + sub-stream header
+			{
+				Platform::log("WARNING: Sub-stream packet too small, dropped in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+				PacketPool::release( pack.buffer );
+				return;
+			}
+			auto& held = m_SubStreamHeld[(u8_t)pack.channel];
+			auto& waiting = m_SubStreamWaiting[(u8_t)pack.channel];
+			u32_t dist = *(u32_t*)&pack.data[1 + off_Sub_Dist];
+			if ( dist != 0 && !isSubStreamReleased( stream, firstSeq - dist ) )
+			{
+				// keeps its place in the ring for when it is released
+				held[lastSeq] = pack;
+				waiting[firstSeq - dist] = lastSeq;
+				m_NumReorderPackets++;
+				return;
+			}
+			// release it and the messages that were waiting on it
+			for (;;)
+			{
+				pack.subStream = *(u32_t*)&pack.data[1 + off_Sub_Id];
+				i8_t id = pack.data[0];
+				if ( PacketPool::isShared( pack.buffer ) )
+				{
+					// datagram is also referenced by others (other packets in it, relay, fec), so do not write into it
+					i8_t* data = PacketPool::alloc( pack.len - hdr_Sub_Size );
+					Platform::memCpy( data + 1, pack.len - hdr_Sub_Size - 1, pack.data + 1 + hdr_Sub_Size, pack.len - hdr_Sub_Size - 1 );
+					PacketPool::release( pack.buffer );
+					pack.buffer = data;
+					pack.data = data;
+				}
+				else
+				{
+					pack.data += hdr_Sub_Size;
+				}
+				pack.data[0] = id; // id just before the user data
+				pack.len -= hdr_Sub_Size;
+				relayFromRecvThread( pack );
+				bool bPushed = m_RecvRing_reliable_order.push( pack );
+				assert( bPushed && "was checked on receive" );
+				auto it = waiting.find( lastSeq );
+				if ( it == waiting.end() )
+					break;
+				lastSeq = it->second;
+				waiting.erase( it );
+				auto heldIt = held.find( lastSeq );
+				pack = heldIt->second;
+				held.erase( heldIt );
+				m_NumReorderPackets--;
+			}
+			return;
+		}
+		relayFromRecvThread( pack );
+		bool bPushed = m_RecvRing_reliable_order.push( pack );
+		assert( bPushed && "was checked on receive" );
+	}
+
+	void RUDPLink::relayFromRecvThread(Packet& pack)
+	{
+		if ( !(pack.flags & RelayBit) || pack.len < 1 || (u8_t)pack.data[0] < USER_ID_OFFSET )
+			return;
+		if ( m_RecvNode->queueRelay( m_RecvShard, pack, this ) )
+		{
+			pack.flags &= ~RelayBit; // game thread must not relay it again
+		}
+	}
+
+	bool RUDPLink::isSubStreamReleased(i32_t stream, u32_t lastSeq) const
+	{
+		// all fragments of a message are received once its last one is, then it is released unless it is held
+		const recvFragmentSlot& slot = m_ReorderRing_reliable[stream][ lastSeq & (m_ReliableWindow-1) ];
+		bool bReceived = !isSequenceNewer( lastSeq, m_RecvSeq_reliable[stream] ) || (slot.filled && slot.delivered && slot.seq == lastSeq);
+		return bReceived && m_SubStreamHeld[stream - sm_NumChannels].count( lastSeq ) == 0;
+	}
+
+	recvFragmentSlot* RUDPLink::getUnreliableFragment(i32_t stream, u32_t seq)
+	{
+		recvFragmentSlot& slot = m_FragmentRing_unreliable[stream][ seq & (sm_UnreliableFragmentWindow-1) ];
+		if ( slot.filled && slot.seq == seq && isSequenceNewer(seq, m_RecvSeq_unreliable[stream]) )
+			return &slot;
+		return nullptr; // empty, overwritten or too old
+	}
+
+	void RUDPLink::receiveUnreliable(u32_t linkId, EHeaderPacketType type, const i8_t * buff, i32_t rawSize, bool recovered)
+	{
+		i32_t channel;
+		bool relay;
+		u32_t seq;
+		bool firstFragment, lastFragment;
+		if ( !deserializeNormalHdr(buff, rawSize, m_RecvCompact, channel, relay, seq, firstFragment, lastFragment) )
+		{
+			Platform::log("WARNING: Serialization error in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE );
+			return;
+		}
+		i32_t stream = getStream( type, channel );
+		bool bSequenced = (type == EHeaderPacketType::Unreliable_Sequenced);
+		i32_t kIdOffset = off_Norm_Id;
+		if ( m_RecvCompact )
+		{
+			seq = expandSequence( seq, m_RecvSeq_unreliable[stream] );
+			kIdOffset = off_Cmp_Norm_Id;
+		}
+
+	//	Platform::log("Incoming unreliable seq: %d, chan %d.",  seq, channel);
+
+		// keep it for recovering a lost packet of its group, also if it is dropped below
+		auto& history = m_FecHistory[channel];
+		if ( bSequenced && !recovered && !history.empty() )
+		{
+			i32_t kTypeOffset = m_RecvCompact ? off_Cmp_Type : off_Type;
+			fecRecvSlot& slot = history[ seq & (sm_FecHistorySize-1) ];
+			PacketPool::release( slot.buffer );
+			PacketPool::addRef( m_RecvBuffer );
+			slot.buffer = m_RecvBuffer;
+			slot.item = buff + kTypeOffset;
+			slot.len  = rawSize - kTypeOffset;
+			slot.seq  = seq;
+		}
+		
+		auto& recvSeq = m_RecvSeq_unreliable[stream];
+		if ( bSequenced )
+		{
+			// drop out of sequence (older) packets, also if rebuilt from fec after newer ones arrived
+			if ( !isSequenceNewer(seq, recvSeq) )
+			{
+			//	Platform::log("But dropped seq: %d not newer than: %d, chan %d.",  seq, recvSeq, channel);
+				return;
+			}
+		}
+		else if ( !(firstFragment && lastFragment) )
+		{
+			// unsequenced, only fragments in the window before the newest fragment can be reassembled
+			u32_t windowBegin = seq - (sm_UnreliableFragmentWindow-1);
+			if ( isSequenceNewer(windowBegin, recvSeq) ) recvSeq = windowBegin;
+			if ( !isSequenceNewer(seq, recvSeq) )
+				return;
+		}
+
+		Packet pack; 
+		if ( firstFragment && lastFragment )
+		{ // not fragmented
+			if ( bSequenced && isSequenceNewer(seq, recvSeq) ) recvSeq = seq+1;
+			createNormalPacket( pack, m_RecvBuffer, buff + kIdOffset, rawSize-kIdOffset, linkId, channel, relay, type );
+			relayFromRecvThread( pack );
+			if ( !m_RecvRing_unreliable_sequenced.push( pack ) )
+			{
+				PacketPool::release( pack.buffer ); // game thread is not polling, drop
+			}
+			return;
+		}
+
+		// unreliable fragmented packet
+		auto& ring = m_FragmentRing_unreliable[stream];
+		if ( ring.empty() )
+		{
+			ring.resize( sm_UnreliableFragmentWindow );
+		}
+		if ( getUnreliableFragment( stream, seq ) )
+			return; // duplicate
+		recvFragmentSlot& slot = ring[ seq & (sm_UnreliableFragmentWindow-1) ];
+		if ( slot.filled )
+		{
+			PacketPool::release( slot.pack.buffer ); // older fragment that was never completed
+		}
+		createNormalPacket( slot.pack, m_RecvBuffer, buff + kIdOffset, rawSize-kIdOffset, linkId, channel, relay, type );
+		if ( firstFragment ) slot.pack.flags |= (FirstFragmentBit);
+		if ( lastFragment )  slot.pack.flags |= (LastFragmentBit);
+		slot.seq = seq;
+		slot.filled = true;
+
+		// Join with the runs of consecutive fragments of the same message on either side, only the ends of a run know its extent.
+		u32_t runBegin = seq;
+		u32_t runEnd   = seq;
+		recvFragmentSlot* prev = firstFragment ? nullptr : getUnreliableFragment( stream, seq-1 );
+		if ( prev && !(prev->pack.flags & LastFragmentBit) && getUnreliableFragment( stream, prev->runBegin ) )
+		{
+			runBegin = prev->runBegin;
+		}
+		recvFragmentSlot* next = lastFragment ? nullptr : getUnreliableFragment( stream, seq+1 );
+		if ( next && !(next->pack.flags & FirstFragmentBit) && getUnreliableFragment( stream, next->runEnd ) )
+		{
+			runEnd = next->runEnd;
+		}
+		if ( runEnd - runBegin >= sm_UnreliableFragmentWindow )
+			return; // cannot be reassembled, will be overwritten
+		recvFragmentSlot& first = ring[ runBegin & (sm_UnreliableFragmentWindow-1) ];
+		recvFragmentSlot& last  = ring[ runEnd & (sm_UnreliableFragmentWindow-1) ];
+		first.runEnd  = runEnd;
+		last.runBegin = runBegin;
+		if ( !(first.pack.flags & FirstFragmentBit) || !(last.pack.flags & LastFragmentBit) )
+			return; // not complete yet
+
+		// reassemble
+		m_FragmentScratch.clear();
+		for (u32_t fragSeq = runBegin; fragSeq != runEnd+1; ++fragSeq) // take into account that seq wraps
+		{
+			recvFragmentSlot* frag = getUnreliableFragment( stream, fragSeq );
+			if ( !frag )
+				return; // part of the run was overwritten by newer fragments
+			m_FragmentScratch.emplace_back( frag->pack );
+		}
+		for (u32_t fragSeq = runBegin; fragSeq != runEnd+1; ++fragSeq)
+		{
+			ring[ fragSeq & (sm_UnreliableFragmentWindow-1) ].filled = false;
+		}
+		defragmentPacket( pack, m_FragmentScratch );
+		pack.flags &= ~(FirstFragmentBit | LastFragmentBit);
+	//	Platform::log("Unreliable Reassmbled firstSeq: %d, lastSeq %d, chan %d, numFragments %d.", runBegin, runEnd, channel, 1+(runEnd-runBegin));
+
+		// older fragments can no longer be processed because a newer big packet was succesfully reassembled, they are overwritten later
+		if ( bSequenced && isSequenceNewer(runEnd+1, recvSeq) ) recvSeq = runEnd + 1;
+		// push new reassembled packet to queue for processing
+		relayFromRecvThread( pack );
+		if ( !m_RecvRing_unreliable_sequenced.push( pack ) )
+		{
+			PacketPool::release( pack.buffer ); // game thread is not polling, drop
+		}
+	}
+
+	void RUDPLink::receiveFecParity(u32_t linkId, const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize < off_Fec_Data )
+		{
+			Platform::log("WARNING: Serialization error in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE );
+			return;
+		}
+		i32_t channel = buff[off_Fec_Chan];
+		u32_t count   = (u8_t)buff[off_Fec_Count];
+		if ( channel < 0 || channel >= sm_NumChannels || count == 0 || count > sm_FecMaxGroupSize )
+		{
+			Platform::log("WARNING: Invalid fec parity detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		auto& history = m_FecHistory[channel];
+		if ( history.empty() )
+		{
+			// sender uses fec on this channel, start keeping packets, this group cannot be recovered
+			history.resize( sm_FecHistorySize );
+			for (auto& slot : history) slot.buffer = nullptr;
+			return;
+		}
+		// xor can only recover a single lost packet
+		u32_t firstSeq = *(u32_t*)&buff[off_Fec_Seq];
+		u32_t numLost  = 0;
+		u16_t len = *(u16_t*)&buff[off_Fec_LenXor];
+		for (u32_t seq = firstSeq; seq != firstSeq+count; ++seq)
+		{
+			const fecRecvSlot& slot = history[ seq & (sm_FecHistorySize-1) ];
+			if ( slot.buffer && slot.seq == seq ) len ^= (u16_t)slot.len;
+			else numLost++;
+		}
+		if ( numLost != 1 )
+			return;
+		if ( len == 0 || len > rawSize - off_Fec_Data )
+		{
+			Platform::log("WARNING: Invalid fec parity detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		bool bCompact = (buff[off_Fec_Flags] & 1) != 0;
+		i32_t kTypeOffset = bCompact ? off_Cmp_Type : off_Type;
+		i8_t* packet = PacketPool::alloc( kTypeOffset + len );
+		if ( bCompact ) serializeCompactLinkId( packet, m_LinkId );
+		else *(u32_t*)packet = m_LinkId;
+		i8_t* item = packet + kTypeOffset;
+		Platform::memCpy( item, len, buff + off_Fec_Data, len );
+		for (u32_t seq = firstSeq; seq != firstSeq+count; ++seq)
+		{
+			const fecRecvSlot& slot = history[ seq & (sm_FecHistorySize-1) ];
+			if ( !(slot.buffer && slot.seq == seq) )
+				continue;
+			i32_t n = Util::min( (i32_t)len, slot.len );
+			for (i32_t i=0; i<n; ++i) item[i] ^= slot.item[i];
+			if ( !bCompact ) item[0] ^= (slot.item[0] & sm_PiggyAckBit); // was not set when parity was made
+		}
+		EHeaderPacketType type = bCompact ? deserializeCompactType( item[0] ) : (EHeaderPacketType)(u8_t)item[0];
+		if ( type == EHeaderPacketType::Unreliable_Sequenced )
+		{
+			// recovered packet is in its own buffer instead of the datagram
+			const i8_t* recvBuffer = m_RecvBuffer;
+			bool bRecvCompact = m_RecvCompact;
+			m_RecvBuffer  = packet;
+			m_RecvCompact = bCompact;
+			receiveUnreliable( linkId, type, packet, kTypeOffset + len, true );
+			m_RecvBuffer  = recvBuffer;
+			m_RecvCompact = bRecvCompact;
+		}
+		else
+		{
+			Platform::log("WARNING: Fec recovered packet of unexpected type %d dropped.", (i32_t)type);
+		}
+		PacketPool::release( packet );
+	}
+
+	void RUDPLink::receiveRedundant(u32_t linkId, const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize < off_Red_Data )
+		{
+			Platform::log("WARNING: Serialization error in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE );
+			return;
+		}
+		i32_t channel = buff[off_Red_ChanNFlags] & 7;
+		bool  relay   = (buff[off_Red_ChanNFlags] & 8) != 0;
+		u32_t seq = *(u32_t*)&buff[off_Red_Seq];
+		u32_t num = (u8_t)buff[off_Red_Num];
+		if ( num == 0 || num > sm_MaxRedundancy+1 )
+		{
+			Platform::log("WARNING: Invalid redundant packet detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		// dedupe, only messages that are newer than the last delivered one are decoded
+		u32_t recvSeq = m_RecvSeq_redundant[channel];
+		if ( !isSequenceNewer( seq, recvSeq ) )
+		{
+			m_RedundantAckPending[channel] = true;
+			scheduleAcks();
+			return;
+		}
+		u32_t numNew = Util::min( num, seq - recvSeq + 1 );
+		Packet packs[sm_MaxRedundancy+1];
+		u32_t numDecoded = 0;
+		i32_t offset = off_Red_Data;
+		const i8_t* ref = nullptr;
+		i32_t refLen = 0;
+		for (; numDecoded < numNew; ++numDecoded)
+		{
+			if ( offset + hdr_Red_Item_Size > rawSize ) break;
+			i32_t len	 = *(u16_t*)&buff[offset];
+			i32_t encLen = *(u16_t*)&buff[offset+2];
+			offset += hdr_Red_Item_Size;
+			if ( len < 1 || offset + encLen > rawSize ) break;
+			i8_t* data = PacketPool::alloc( len );
+			if ( !decodeDelta( data, len, buff + offset, encLen, ref, refLen ) )
+			{
+				PacketPool::release( data );
+				break;
+			}
+			offset += encLen;
+			Packet& pack = packs[numDecoded];
+			pack.linkId = linkId;
+			pack.len  = len;
+			pack.data = data;
+			pack.buffer  = data;
+			pack.channel = channel;
+			pack.type  = EHeaderPacketType::Unreliable_Redundant;
+			pack.flags = relay;
+			pack.subStream = 0;
+			ref = data;
+			refLen = len;
+		}
+		if ( numDecoded != numNew )
+		{
+			Platform::log("WARNING: Invalid redundant packet detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			for (u32_t i=0; i<numDecoded; ++i) PacketPool::release( packs[i].buffer );
+			return;
+		}
+		m_RecvSeq_redundant[channel] = seq+1;
+		m_RedundantAckPending[channel] = true;
+		scheduleAcks();
+		// oldest first, messages that were not in any received datagram are skipped
+		for (u32_t i=numDecoded; i-- > 0; )
+		{
+			relayFromRecvThread( packs[i] );
+			if ( !m_RecvRing_unreliable_sequenced.push( packs[i] ) )
+			{
+				PacketPool::release( packs[i].buffer ); // game thread is not polling, drop
+			}
+		}
+	}
+
+	void RUDPLink::receiveAckRedundant(const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize < hdr_Ack_Red_Size+hdr_Generic_Size )
+		{
+			Platform::log("WARNING: Invalid redundant ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		i32_t channel = buff[off_Ack_Red_Chan];
+		if ( channel < 0 || channel >= sm_NumChannels )
+		{
+			Platform::log("WARNING: Invalid redundant ack channel detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		// acks can arrive out of order
+		u32_t ackSeq = *(u32_t*)(buff + off_Ack_Red_Seq);
+		if ( isSequenceNewer( ackSeq, m_RedundantAcked[channel] ) )
+			m_RedundantAcked[channel] = ackSeq;
+	}
+
+	void RUDPLink::receiveReliableNewest(u32_t linkId, const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize < hdr_Relnew_Size )
+		{
+			Platform::log("WARNING: Invalid reliable newest data, too short. In %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+
+		// If sequence is older than already received, discarda all info, but ack again as the previous ack may have been lost
+		u32_t seq = *(u32_t*)(buff + off_RelNew_Seq);
+		if ( !isSequenceNewer(seq, m_RecvSeq_reliable_newest) )
+		{
+			m_RelNewestAckPending = true;
+			scheduleAcks();
+			return;
+		}
+
+		// game thread is not polling, do not ack so that it is resent
+		if ( m_RecvRing_reliable_newest.freeSpace() == 0 )
+			return;
+		
+		// from now on only interested in current sequence +1
+		m_RecvSeq_reliable_newest = seq+1;					
+
+		// do further processing of individual groups in higher level group unwrap system
+		Packet pack;
+		createNormalPacket( pack, m_RecvBuffer, buff + off_RelNew_Num, rawSize - off_RelNew_Num, linkId, 0, false, EHeaderPacketType::Reliable_Newest );
+		m_RecvRing_reliable_newest.push( pack );
+		// after the sequence is updated, so that the ack includes it
+		m_RelNewestAckPending = true;
+		scheduleAcks();
+	}
+
+	void RUDPLink::receiveAck(const i8_t * buff, i32_t rawSize)
+	{
+		if (rawSize < hdr_Ack_Size)
+		{
+			Platform::log("WARNING: Invalid ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		i32_t channel = buff[off_Ack_Chan];
 		i32_t num	 = *(i32_t*)(buff + off_Ack_Num); // num of acks
 		if (rawSize - (hdr_Ack_Size+hdr_Generic_Size) != num*4)
 		{
 			Platform::log("WARNING: Invalid ack payload detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
 			return;
 		}
-		std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
-		auto& queue = m_RetransmitQueue_reliable[channel];
-		for (i32_t i = 0; i < num; ++i) // for each ack, try to find it, and remove as was succesfully transmitted
+		if (channel < 0 || channel >= sm_NumStreams)
 		{
-			// remove from send queue if we receive an ack for the packet
-			u32_t seq = *(u32_t*)(buff + (i*4) + off_Ack_Payload);
-			auto it   = std::find_if(queue.begin(), queue.end(), [seq](auto& pack)
+			Platform::log("WARNING: Invalid ack channel detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		i32_t rttSample = -1;
+		bool bLost = false;
+		{
+			std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
+			for (i32_t i = 0; i < num; ++i) // for each ack, try to find it, and remove as was succesfully transmitted
 			{
-				return *(u32_t*)&pack.data[off_Norm_Seq] == seq;
-			});
-			if (it != queue.end())
+				// remove from send queue if we receive an ack for the packet
+				u32_t seq = *(u32_t*)(buff + (i*4) + off_Ack_Payload);
+				removeAckedFragment( channel, seq, rttSample );
+			}
+			i32_t tNow = Util::timeNow();
+			bLost = detectLostFragments( channel, tNow );
+			// timed out ones that wait for room in the window
+			bLost |= hasRetransmitDue( tNow );
+		}
+		if ( rttSample >= 0 )
+		{
+			updateRoundTripTime( rttSample );
+		}
+		// acks make room in the (congestion) window, let send thread push out waiting data and resend lost data
+		if ( m_HasReliableBacklog || bLost )
+		{
+			m_RecvNode->scheduleLink( this, ELinkTimer::Send, 0 );
+		}
+	}
+
+	void RUDPLink::receiveSelectiveAcks(const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize < 1 || (u8_t)buff[rawSize-1] * hdr_Sack_Size + 1 != rawSize )
+		{
+			Platform::log("WARNING: Invalid selective ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		i32_t num = (u8_t)buff[rawSize-1];
+		i32_t rttSample = -1;
+		bool bLost = false;
+		{
+			std::lock_guard<std::mutex> lock(m_ReliableOrderedQueueMutex);
+			i32_t tNow = Util::timeNow();
+			for (i32_t i = 0; i < num; ++i)
 			{
-		//		Platform::log("Packet with seq: %d chan %d, acked.", seq, channel);
-				auto& pack = (*it);
-				delete [] pack.data;
-				queue.erase(it);
+				const i8_t* block = buff + i*hdr_Sack_Size;
+				i8_t  channel = block[off_Sack_Chan] & (sm_NumStreams-1);
+				u32_t latest  = *(u32_t*)(block + off_Sack_Latest);
+				u32_t mask    = *(u32_t*)(block + off_Sack_Mask);
+				removeAckedFragment( channel, latest, rttSample );
+				for (u32_t bit = 0; mask != 0; ++bit, mask >>= 1)
+				{
+					if ( mask & 1 ) removeAckedFragment( channel, latest-1-bit, rttSample );
+				}
+				bLost |= detectLostFragments( channel, tNow );
 			}
+			// timed out ones that wait for room in the window
+			bLost |= hasRetransmitDue( tNow );
+		}
+		if ( rttSample >= 0 )
+		{
+			updateRoundTripTime( rttSample );
+		}
+		// acks make room in the (congestion) window, let send thread push out waiting data and resend lost data
+		if ( m_HasReliableBacklog || bLost )
+		{
+			m_RecvNode->scheduleLink( this, ELinkTimer::Send, 0 );
+		}
+	}
+
+	bool RUDPLink::removeAckedFragment(i32_t channel, u32_t seq, i32_t& rttSample)
+	{
+		reliableOrderedItem* slot = getRetransmitSlot( channel, seq );
+		if ( !slot || !slot->inFlight || slot->seq != seq )
+			return false;
+	//	Platform::log("Packet with seq: %d chan %d, acked.", seq, channel);
+		auto& item = *slot;
+		// Karn: only sample packets that were transmitted once, otherwise it is unknown which transmission is acked
+		i32_t itemRtt = -1;
+		if ( item.numTransmits == 1 )
+		{
+			itemRtt = Util::getTimeSince( item.lastSendTS );
+			rttSample = Util::max( rttSample, itemRtt );
+		}
+		if ( item.countedInFlight )
+		{
+			m_BytesInFlight -= item.pack.len;
+		}
+		if ( m_CongestionControl )
+		{
+			m_CongestionControl->onAck( item.pack.len, itemRtt, getLatency(), Util::timeNow() );
+		}
+		if ( isSequenceNewer( seq, m_HighestAcked_reliable[channel] ) )
+		{
+			m_HighestAcked_reliable[channel] = seq;
+		}
+		if ( (item.lastSendTS - m_NewestAckedSendTS) > 0 )
+		{
+			m_NewestAckedSendTS = item.lastSendTS;
+		}
+		m_RetransmitTimers.erase( item.timer );
+		u8_t userChannel = channel % sm_NumChannels;
+		m_QueuedBytes[userChannel] -= item.pack.len;
+		if ( item.pack.flags & LastFragmentBit ) m_QueuedMessages[userChannel]--;
+		releaseSendPacket( item.pack );
+		item.inFlight = false;
+		// slide window over acked fragments
+		u32_t& base = m_RetransmitBase_reliable[channel];
+		auto&  ring = m_RetransmitRing_reliable[channel];
+		while ( base != m_RetransmitNext_reliable[channel] && !ring[ base & (m_ReliableWindow-1) ].inFlight )
+		{
+			base++;
+		}
+		return true;
+	}
+
+	bool RUDPLink::detectLostFragments(i32_t channel, i32_t timeNow)
+	{
+		auto& ring = m_RetransmitRing_reliable[channel];
+		u32_t highest = m_HighestAcked_reliable[channel];
+		bool bLost = false;
+		// Instead of waiting for the retransmission timer, consider a fragment lost when enough later fragments were acked.
+		for (u32_t seq = m_RetransmitBase_reliable[channel]; seq != m_RetransmitNext_reliable[channel]; ++seq)
+		{
+			if ( !isSequenceNewer( highest, seq + sm_FastRetransmitThreshold ) )
+				break;
+			reliableOrderedItem& item = ring[ seq & (m_ReliableWindow-1) ];
+			if ( !item.inFlight || !item.countedInFlight )
+				continue;
+			// a retransmission is only lost if something sent after it was acked
+			if ( item.numTransmits > 1 && (m_NewestAckedSendTS - item.lastSendTS) <= 0 )
+				continue;
+			item.countedInFlight = false;
+			m_BytesInFlight -= item.pack.len;
+			if ( m_CongestionControl ) m_CongestionControl->onLoss( getLatency(), timeNow, false );
+			// resend on first occasion by send thread
+			m_RetransmitTimers.erase( item.timer );
+			setRetransmitTimer( item, timeNow );
+			bLost = true;
+		}
+		return bLost;
+	}
+
+	reliableOrderedItem* RUDPLink::getRetransmitSlot(i32_t channel, u32_t seq)
+	{
+		auto& ring = m_RetransmitRing_reliable[channel];
+		if ( ring.empty() )
+			return nullptr;
+		return &ring[ seq & (m_ReliableWindow-1) ];
+	}
+
+	const reliableOrderedItem* RUDPLink::getRetransmitSlot(i32_t channel, u32_t seq) const
+	{
+		auto& ring = m_RetransmitRing_reliable[channel];
+		if ( ring.empty() )
+			return nullptr;
+		return &ring[ seq & (m_ReliableWindow-1) ];
+	}
+
+	void RUDPLink::receiveMtuProbe(const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize < hdr_Generic_Size + hdr_Mtu_Size || *(u16_t*)(buff + off_Mtu_Size) != rawSize )
+		{
+			Platform::log("WARNING: Invalid mtu probe size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		i8_t ack[hdr_Generic_Size + hdr_Mtu_Size];
+		*(u32_t*)ack = m_LinkId;
+		ack[off_Type] = (i8_t)EHeaderPacketType::Mtu_Probe_Ack;
+		*(u16_t*)(ack + off_Mtu_Size) = (u16_t)rawSize;
+		m_RecvNode->getSocket()->send( m_EndPoint, ack, sizeof(ack) );
+	}
+
+	void RUDPLink::receiveMtuProbeAck(const i8_t* buff, i32_t rawSize)
+	{
+		if ( rawSize != hdr_Generic_Size + hdr_Mtu_Size )
+		{
+			Platform::log("WARNING: Invalid mtu probe ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
+			return;
+		}
+		m_MtuProbeAckSize = *(u16_t*)(buff + off_Mtu_Size); // handled by send thread
+		m_RecvNode->scheduleLink( this, ELinkTimer::MtuProbe, 0 );
+	}
+
+	void RUDPLink::updateRoundTripTime(i32_t sampleMs)
+	{
+		// RFC 6298, alpha = 1/8, beta = 1/4
+		float sample = (float)sampleMs;
+		if ( !m_HasRttSample )
+		{
+			m_SmoothedRttF = sample;
+			m_RttVarianceF = sample*.5f;
+			m_HasRttSample = true;
+		}
+		else
+		{
+			float diff = m_SmoothedRttF - sample;
+			m_RttVarianceF = .75f*m_RttVarianceF + .25f*(diff < 0 ? -diff : diff);
+			m_SmoothedRttF = .875f*m_SmoothedRttF + .125f*sample;
+		}
+		i32_t rto = (i32_t)(m_SmoothedRttF + Util::max(1.f, 4.f*m_RttVarianceF) + .5f);
+		m_SmoothedRtt = (u32_t)(m_SmoothedRttF + .5f);
+		m_RttVariance = (u32_t)(m_RttVarianceF + .5f);
+		m_RetransmitTimeout = (u32_t)Util::min( sm_MaxRtoMs, Util::max( sm_MinRtoMs, rto ) );
+	}
+
+	void RUDPLink::dispatchRedundantAckQueue(ISocket* socket)
+	{
+		if ( !isConnected() ) return;
+		for (i32_t i=0; i<sm_NumChannels; ++i)
+		{
+			// acked again on every received datagram, in case the previous ack got lost
+			if ( !m_RedundantAckPending[i].exchange( false ) )
+				continue;
+			i8_t buff[32];
+			*(u32_t*)buff = m_LinkId;
+			buff[off_Type] = (i8_t)EHeaderPacketType::Ack_Redundant;
+			buff[off_Ack_Red_Chan] = (i8_t)i;
+			*(u32_t*)(buff + off_Ack_Red_Seq) = m_RecvSeq_redundant[i];
+			socket->send(m_EndPoint, buff, hdr_Ack_Red_Size+hdr_Generic_Size);
 		}
 	}
 
 	void RUDPLink::receiveAckRelNewest(const i8_t* buff, i32_t rawSize)
 	{
-		if (rawSize < hdr_Ack_RelNew_Size)
+		if (rawSize < hdr_Generic_Size + hdr_Ack_RelNew_Size)
 		{
 			Platform::log("WARNING: Invalid reliable newest ack size detected in %s, line %d.", ZERODELAY_FUNCTION, ZERODELAY_LINE);
 			return;
 		}
 
-		u32_t ackSeq = *(u32_t*)buff;
+		u32_t ackSeq = *(u32_t*)(buff + off_Ack_RelNew_Seq);
 		//Util::read(buff, ackSeq);
 		if ( !isSequenceNewer( ackSeq, m_RecvSeq_reliable_newest_ack ) )
 			return; // if sequence is already acked, ignore
@@ -682,7 +2151,7 @@ namespace Zerodelay
 			bool removeGroup = true;
 			for (auto& item : group.groupItems)
 			{
-				if ( isSequenceNewer( item.remoteRevision, item.localRevision ) )
+				if ( item.localRevision != item.remoteRevision && isSequenceNewer( item.localRevision, item.remoteRevision ) )
 				{
 					removeGroup = false; // cannot remove group (local revision is newer than received one)
 					break;
@@ -692,7 +2161,10 @@ namespace Zerodelay
 			if ( removeGroup )
 			{
 				for(auto & groupItem : group.groupItems) // cleanup data
+				{
+					m_QueuedBytes_reliable_newest -= groupItem.dataCapacity;
 					delete [] groupItem.data;
+				}
 				it = queue.erase(it);
 			}
 			else
@@ -705,23 +2177,71 @@ namespace Zerodelay
 
 	// ----------------- Support functions (does not touch class data) -----------------------------------------------
 
-	void RUDPLink::serializeNormalPacket(std::vector<Packet>& packs, u32_t linkId, EHeaderPacketType packetType, u8_t dataId, const i8_t* data, i32_t len, i32_t fragmentSize, i8_t channel, bool relay)
+	i32_t RUDPLink::getStream(EHeaderPacketType type, i32_t channel)
+	{
+		if ( type == EHeaderPacketType::Reliable_Unordered || type == EHeaderPacketType::Unreliable || type == EHeaderPacketType::Reliable_SubStream )
+			return channel + sm_NumChannels;
+		return channel;
+	}
+
+	const i8_t* RUDPLink::allocSharedPayload(EHeaderPacketType packetType, const i8_t* data, i32_t len)
 	{
+		// sub-stream and redundant messages get per link data in front of the payload
+		bool bSharable = packetType == EHeaderPacketType::Reliable_Ordered || packetType == EHeaderPacketType::Reliable_Unordered ||
+						 packetType == EHeaderPacketType::Unreliable_Sequenced || packetType == EHeaderPacketType::Unreliable;
+		if ( !bSharable || len < sm_SharedPayloadMinSize )
+			return nullptr;
+		i8_t* payload = PacketPool::alloc( len );
+		Platform::memCpy( payload, len, data, len );
+		return payload;
+	}
+
+	void RUDPLink::serializeNormalPacket(std::vector<Packet>& packs, u32_t linkId, EHeaderPacketType packetType, u8_t dataId, const i8_t* data, i32_t len, i32_t fragmentSize, i8_t channel, bool relay, bool compact,
+											 const i8_t* sharedPayload)
+	{
+		// in compact header, channel and flags are in the type byte
+		i32_t kFlagsOffset = compact ? off_Cmp_Type : off_Norm_ChanNFlags;
+		i32_t kDataOffset  = compact ? off_Cmp_Norm_Data : off_Norm_Data;
 		bool bStartFragment = true;
 		u32_t offset = 0;
 		while (len > 0 || bStartFragment) // allow zero length payload packets
 		{
 			Packet pack;
 			u32_t payloadLen = Util::min(len, fragmentSize);
-			pack.data = new i8_t[payloadLen+off_Norm_Data];
-			*(u32_t*)(pack.data + off_Link) = linkId;
-			pack.data[off_Type] = (i8_t)packetType;
-			pack.data[off_Norm_ChanNFlags] = channel;
-			pack.data[off_Norm_ChanNFlags] |= ((i8_t)relay) << 3; // skip over the bits for channel, 0 to 7
-			pack.data[off_Norm_ChanNFlags] |= ((i8_t)bStartFragment) << 4; // first fragment bit
-			pack.data[off_Norm_Id] = dataId;
-			Platform::memCpy(pack.data + off_Norm_Data, payloadLen, data + offset, payloadLen);
-			pack.len = payloadLen + off_Norm_Data;
+			// only the header is per link if the payload is shared
+			pack.data = PacketPool::alloc( sharedPayload ? kDataOffset : payloadLen+kDataOffset );
+			pack.buffer = pack.data;
+			pack.payload = nullptr;
+			pack.payloadBuffer = nullptr;
+			pack.payloadLen = 0;
+			pack.flags = (relay ? RelayBit : 0) | (bStartFragment ? FirstFragmentBit : 0);
+			if ( compact )
+			{
+				serializeCompactLinkId( pack.data, linkId );
+				pack.data[off_Cmp_Type] = (i8_t)((packetType == EHeaderPacketType::Reliable_Ordered ? 1 : 2) << sm_CompactKindShift);
+			}
+			else
+			{
+				*(u32_t*)(pack.data + off_Link) = linkId;
+				pack.data[off_Type] = (i8_t)packetType;
+				pack.data[off_Norm_ChanNFlags] = 0;
+			}
+			pack.data[kFlagsOffset] |= channel;
+			pack.data[kFlagsOffset] |= ((i8_t)relay) << 3; // skip over the bits for channel, 0 to 7
+			pack.data[kFlagsOffset] |= ((i8_t)bStartFragment) << 4; // first fragment bit
+			pack.data[kDataOffset-1] = dataId;
+			if ( sharedPayload && payloadLen > 0 )
+			{
+				PacketPool::addRef( sharedPayload );
+				pack.payload = sharedPayload + offset;
+				pack.payloadBuffer = sharedPayload;
+				pack.payloadLen = payloadLen;
+			}
+			else
+			{
+				Platform::memCpy(pack.data + kDataOffset, payloadLen, data + offset, payloadLen);
+			}
+			pack.len = payloadLen + kDataOffset;
 			packs.emplace_back(pack);
 			// prepare next fragment
 			bStartFragment = false;
@@ -729,101 +2249,152 @@ namespace Zerodelay
 			offset += payloadLen;
 		}
 		// set last fragment bit in last packet
-		packs.back().data[off_Norm_ChanNFlags] |= ((i8_t)1) << 5; // last fragment bit
+		packs.back().data[kFlagsOffset] |= ((i8_t)1) << 5; // last fragment bit
+		packs.back().flags |= LastFragmentBit;
+	}
+
+	void RUDPLink::releaseSendPacket(const Packet& pack)
+	{
+		PacketPool::release( pack.buffer );
+		PacketPool::release( pack.payloadBuffer );
+	}
+
+	void RUDPLink::serializeCompactLinkId(i8_t* buff, u32_t linkId)
+	{
+		u32_t shortId = (linkId >> 8) & sm_CompactLinkIdMask;
+		buff[0] = (i8_t)(sm_CompactHdrBit | (shortId & 0x3F)); // below piggy ack bit
+		buff[1] = (i8_t)(shortId >> 6);
 	}
 
 	bool RUDPLink::deserializeGenericHdr(const i8_t* buff, i32_t rawSize, u32_t& linkIdOut, EHeaderPacketType& packetType)
 	{
 		if ( rawSize < hdr_Generic_Size ) return false;
 		linkIdOut  = *(u32_t*)(buff + off_Link);
-		packetType = (EHeaderPacketType)*(buff + off_Type);
+		packetType = (EHeaderPacketType)((u8_t)*(buff + off_Type) & ~sm_PiggyAckBit);
 		return true;
 	}
 
-	bool RUDPLink::deserializeNormalHdr(const i8_t* buff, i32_t rawSize, i8_t& channel, bool& relay, u32_t& seq, bool& firstFragment, bool& lastFragment)
+	EHeaderPacketType RUDPLink::deserializeCompactType(i8_t typeByte)
+	{
+		switch ( (u8_t)typeByte >> sm_CompactKindShift )
+		{
+		case 0: return (EHeaderPacketType)(typeByte & ((1 << sm_CompactKindShift)-1));
+		case 1: return EHeaderPacketType::Reliable_Ordered;
+		case 2: return EHeaderPacketType::Unreliable_Sequenced;
+		}
+		return (EHeaderPacketType)0xFF; // unknown, dropped
+	}
+
+	bool RUDPLink::deserializeNormalHdr(const i8_t* buff, i32_t rawSize, bool compact, i32_t& channel, bool& relay, u32_t& seq, bool& firstFragment, bool& lastFragment)
 	{
-		if ( rawSize <= hdr_Norm_Size ) return false; 
-		channel = (buff[off_Norm_ChanNFlags] & 7);		// first 3 bits [0 - 2]
-		relay   = (buff[off_Norm_ChanNFlags] & 8) != 0;	// 3rth bit
-		firstFragment = (buff[off_Norm_ChanNFlags] & 16) != 0; // 4th bit
-		lastFragment  = (buff[off_Norm_ChanNFlags] & 32) != 0; // 5th bit
-		seq		= *(u32_t*)(buff + off_Norm_Seq);
+		i8_t chanNFlags;
+		if ( compact )
+		{
+			if ( rawSize < off_Cmp_Norm_Data ) return false;
+			chanNFlags = buff[off_Cmp_Type];
+			seq		   = *(u16_t*)(buff + off_Cmp_Norm_Seq);
+		}
+		else
+		{
+			if ( rawSize <= hdr_Norm_Size ) return false; 
+			chanNFlags = buff[off_Norm_ChanNFlags];
+			seq		   = *(u32_t*)(buff + off_Norm_Seq);
+		}
+		channel = (chanNFlags & 7);		// first 3 bits [0 - 2]
+		relay   = (chanNFlags & 8) != 0;	// 3rth bit
+		firstFragment = (chanNFlags & 16) != 0; // 4th bit
+		lastFragment  = (chanNFlags & 32) != 0; // 5th bit
 		return true;
 	}
 
-	void RUDPLink::createNormalPacket(Packet& pack, const i8_t* buff, i32_t dataSize, u32_t linkId, i8_t channel, 
+	void RUDPLink::createNormalPacket(Packet& pack, const i8_t* recvBuffer, const i8_t* buff, i32_t dataSize, u32_t linkId, i8_t channel, 
 									  bool relay, EHeaderPacketType type)
 	{
+		// no copy, packet references the data in the received datagram
+		PacketPool::addRef( recvBuffer );
 		pack.linkId = linkId;
 		pack.len  = dataSize;
-		pack.data = new i8_t[pack.len];
+		pack.data = (i8_t*)buff;
+		pack.buffer  = recvBuffer;
 		pack.channel = channel;
 		pack.type  = type;
 		pack.flags = relay;
-		Platform::memCpy(pack.data, pack.len, buff, pack.len); 
+		pack.subStream = 0;
+	}
+
+	i32_t RUDPLink::encodeDelta(i8_t* out, i32_t outSize, const i8_t* data, i32_t len, const i8_t* ref, i32_t refLen)
+	{
+		// xor with the reference, which is zero beyond its length
+		auto delta = [&](i32_t i) { return (i8_t)(i < refLen ? data[i] ^ ref[i] : data[i]); };
+		i32_t outLen = 0;
+		i32_t i = 0;
+		while ( i < len )
+		{
+			i32_t numZeros = 0;
+			while ( i < len && numZeros < 255 && delta(i) == 0 ) { numZeros++; i++; }
+			// a single zero does not end the literals, a new run costs two bytes
+			i32_t litBegin = i;
+			while ( i < len && i-litBegin < 255 && !(delta(i) == 0 && (i+1 == len || delta(i+1) == 0)) ) i++;
+			i32_t numLits = i - litBegin;
+			if ( outLen + 2 + numLits > outSize )
+				return -1;
+			out[outLen++] = (i8_t)numZeros;
+			out[outLen++] = (i8_t)numLits;
+			for (i32_t k=litBegin; k<i; ++k) out[outLen++] = delta(k);
+		}
+		return outLen;
+	}
+
+	bool RUDPLink::decodeDelta(i8_t* out, i32_t len, const i8_t* enc, i32_t encLen, const i8_t* ref, i32_t refLen)
+	{
+		i32_t i = 0;
+		i32_t k = 0;
+		while ( i < len )
+		{
+			if ( k + 2 > encLen ) return false;
+			i32_t numZeros = (u8_t)enc[k++];
+			i32_t numLits  = (u8_t)enc[k++];
+			if ( i + numZeros + numLits > len || k + numLits > encLen ) return false;
+			for (i32_t n=0; n<numZeros; ++n, ++i) out[i] = (i < refLen ? ref[i] : 0);
+			for (i32_t n=0; n<numLits; ++n, ++i) out[i] = (i < refLen ? ref[i] ^ enc[k++] : enc[k++]);
+		}
+		return k == encLen;
 	}
 
-	void RUDPLink::defragmentPacket(Packet& pack, u32_t beginSeq, u32_t lastSeq, std::map<u32_t, Packet>& fragments)
+	void RUDPLink::defragmentPacket(Packet& pack, std::vector<Packet>& fragments)
 	{
 		// copy id, type etc from first fragment
-		pack = fragments.begin()->second;
+		pack = fragments.front();
 		u32_t len = 0;
-		u32_t curSeq = beginSeq;
-		while (curSeq != lastSeq+1) // take into account that seq wraps
+		for (auto& frag : fragments)
 		{
-			len += fragments[curSeq].len - 1; // length includes data hdr id
-			curSeq++;
+			len += frag.len - 1; // length includes data hdr id
 		}
-		pack.data = new i8_t[len+1]; // + 1 for data hdr id
+		pack.data = PacketPool::alloc( len+1 ); // + 1 for data hdr id
+		pack.buffer = pack.data;
 		pack.len  = len+1;
-		pack.data[0] = fragments.begin()->second.data[0]; // data hdr id
+		pack.data[0] = fragments.front().data[0]; // data hdr id
 		u32_t curLen = 1;
-		curSeq = beginSeq;
-		while (curSeq != lastSeq+1) // take into account that seq wraps
+		for (auto& frag : fragments)
 		{
-			auto fragIt = fragments.find(curSeq);
-			const Packet& frag = fragIt->second;
 			u32_t copySize = frag.len-1; // subtract data id (-1)
 			Platform::memCpy(pack.data + curLen, (len+1-curLen), frag.data+1, copySize);
-			delete [] frag.data;
-			fragments.erase(fragIt);
+			PacketPool::release( frag.buffer );
 			curLen += copySize;
-			curSeq++;
 		}
+		fragments.clear();
 		// zero out the first/last fragment bit in the flags for cleanness (upper layer is not interested in this)
 		pack.flags &= ~FirstFragmentBit;
 		pack.flags &= ~LastFragmentBit;
 	}
 
-	bool RUDPLink::tryReassembleBigPacket(Packet& finalPack, std::map<u32_t, Packet>& fragments, u32_t seq, u32_t& seqBegin, u32_t& seqEnd)
+	bool RUDPLink::isSequenceNewer(u32_t incoming, u32_t having)
 	{
-		seqBegin = seq;
-		while ( fragments.count( seqBegin ) != 0 && (fragments[seqBegin].flags & FirstFragmentBit) == 0 )
-		{
-			seqBegin--;
-		}
-
-		// if found start
-		if ( fragments.count(seqBegin) && (fragments[seqBegin].flags & FirstFragmentBit) != 0)
-		{
-			seqEnd = seq;
-			while ( fragments.count( seqEnd ) != 0 && (fragments[seqEnd].flags & LastFragmentBit) == 0 )
-			{
-				seqEnd++;
-			}
-
-			// if has end
-			if ( fragments.count(seqEnd) && (fragments[seqEnd].flags & LastFragmentBit) != 0 )
-			{
-				defragmentPacket( finalPack, seqBegin, seqEnd, fragments );
-				return true;
-			}
-		}
-		return false;
+		return (incoming - having) <= (UINT_MAX>>1);
 	}
 
-	bool RUDPLink::isSequenceNewer(u32_t incoming, u32_t having)
+	u32_t RUDPLink::expandSequence(u32_t truncated, u32_t reference)
 	{
-		return (incoming - having) <= (UINT_MAX>>1);
+		return reference + (i32_t)(i16_t)(u16_t)(truncated - reference);
 	}
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "Zerodelay.h"
 #include "EndPoint.h"
 #include "RecvNode.h"
+#include "CongestionControl.h"
+#include "SpscRing.h"
+#include "TimerWheel.h"
 
 #include <atomic>
 #include <vector>
@@ -32,12 +35,117 @@ namespace Zerodelay
 	};
 
 
+	// Retransmission timers of a link ordered by due time (ms) relative to a base, so that the wrapping clock does not break the order.
+	typedef std::multimap<i32_t, struct reliableOrderedItem*> retransmitTimerMap;
+
+	// A reliable ordered fragment that is waiting to be acknowledged. Lives in a ring buffer slot (seq & mask).
+	struct reliableOrderedItem
+	{
+		Packet pack;
+		u32_t  seq;
+		bool   inFlight;		// if false, slot is free
+		i32_t  lastSendTS;		// ms, time of last (re)transmission
+		i32_t  rto;				// ms, timeout for current transmission, doubles on every retransmit
+		u32_t  numTransmits;	// if more than 1, its ack is ambiguous and cannot be used for a round trip sample (Karn)
+		bool   countedInFlight;	// false after its timer expired (considered lost) until it is retransmitted
+		retransmitTimerMap::iterator timer;
+	};
+
+
+	// A received packet or fragment in a sequence buffer slot (seq & mask), waiting to be delivered in order or reassembled.
+	struct recvFragmentSlot
+	{
+		Packet pack;
+		u32_t  seq;
+		bool   filled;
+		bool   delivered;	// reliable unordered only, handed to game thread already (pack is no longer valid)
+		u32_t  runBegin;	// unreliable only, first seq of consecutive fragments of the same message, valid in last slot of the run
+		u32_t  runEnd;		// unreliable only, last seq of the run, valid in first slot of the run
+	};
+
+
+	// Selective ack of a stream that was pushed out of the ack window before it was sent.
+	struct sackBlock
+	{
+		u32_t latest;
+		u32_t mask;
+		i8_t  stream;
+	};
+
+
+	// An unreliable redundant message that is repeated in the datagrams of newer messages until the remote acks it.
+	struct redundantSendItem
+	{
+		std::vector<i8_t> data;	// id followed by payload
+		u32_t seq;
+	};
+
+
+	// Xor of the unreliable sequenced packets of a channel since the last parity was sent (forward error correction).
+	struct fecSendGroup
+	{
+		std::vector<i8_t> parity;	// packets from type byte on, shorter ones padded with zeros
+		u32_t firstSeq;
+		u16_t lenXor;
+		u8_t  count;
+		bool  compact;
+	};
+
+	// A received unreliable sequenced packet, kept to recover a lost packet of its group from the parity.
+	struct fecRecvSlot
+	{
+		const i8_t* buffer;	// PacketPool buffer of the datagram, nullptr if empty
+		const i8_t* item;	// packet from type byte on
+		i32_t  len;
+		u32_t  seq;
+	};
+
+
 	class RUDPLink
 	{
 	public:
 		static const i32_t sm_MaxLingerTimeMs  = 1000;
 		static const i32_t sm_MaxItemsPerGroup = 16;
 
+		// Round trip estimation (RFC 6298 style), all in milliseconds
+		static const i32_t sm_InitialRttMs = 100;		// used until first ack is measured
+		static const i32_t sm_MinRtoMs = 20;			// lower bound of retransmission timeout, ack aggregation delay must fit in
+		static const i32_t sm_MaxRtoMs = 3000;
+		static const i32_t sm_RetransmitRebaseMs = 1<<30;	// timers are rekeyed before their relative due time can overflow
+
+		// Max number of unacked reliable fragments in flight per channel, must be power of two
+		static const u32_t sm_DefaultReliableWindow = 512;
+		static const u32_t sm_FastRetransmitThreshold = 3;	// fragment is lost if this many later fragments were acked
+
+		// Capacity of the rings that hand received packets to the game thread, must be power of two
+		static const u32_t sm_RecvRingSize_reliable_order = 1024;
+		static const u32_t sm_RecvRingSize_unreliable = 1024;
+		static const u32_t sm_RecvRingSize_reliable_newest = 64;
+		// Max fragments of an unreliable message, must be power of two
+		static const u32_t sm_UnreliableFragmentWindow = 256;
+		// Forward error correction of unreliable sequenced packets, a parity packet is sent after each group
+		static const u32_t sm_FecMaxGroupSize = 32;
+		static const u32_t sm_FecHistorySize  = 64;		// received packets kept per channel, power of two and at least twice the max group
+		// Input redundancy, each unreliable redundant datagram repeats up to this many previous unacked messages
+		static const u32_t sm_DefaultRedundancy = 8;
+		static const u32_t sm_MaxRedundancy = 32;
+		// Payloads of at least this size are built once and referenced by each link when sent to multiple links
+		static const i32_t sm_SharedPayloadMinSize = 128;
+		// Sub-streams that are fully acked are forgotten when the map of a channel exceeds this (grows with the number of active ones)
+		static const u32_t sm_SubStreamMinPruneSize = 64;
+		// Reliable data queued per link (unacked or waiting for room in the window) before user sends would block, 0 is unlimited
+		static const u32_t sm_DefaultSendBudgetBytes = 8*1024*1024;
+		static const u32_t sm_DefaultSendBudgetMessages = 16384;
+
+		// Datagram size probing (DPLPMTUD, RFC 8899 style), sizes are UDP payloads
+		static const i32_t sm_MtuBaseSize = 1200;				// assumed to fit any path (Ipv6 minimum MTU is 1280 incl. Ip/Udp header)
+		static const i32_t sm_MtuMaxSize  = ZERODELAY_BUFF_SIZE;
+		static const i32_t sm_MtuEthernetSize = 1472;			// probed first, most paths have a 1500 byte MTU
+		static const i32_t sm_MtuSearchGranularity = 16;		// search is done if largest acked and smallest lost probe are this close
+		static const i32_t sm_MtuMaxProbes = 3;					// probe size is too big if this many probes of it are lost
+		static const i32_t sm_MtuRaiseIntervalMs = 600000;		// search again after this time, the path may have changed
+		static const u32_t sm_MtuBlackHoleTransmits = 4;		// fall back to base size if a datagram above it is sent this many times without ack
+
 		
 		// Generic packet overhead
 		static const i32_t off_Link = 0;
@@ -52,6 +160,12 @@ namespace Zerodelay
 		static const i32_t off_Norm_Data = 11;		// Normal, Payload
 		static const i32_t hdr_Norm_Size = (off_Norm_Id - off_Norm_ChanNFlags); // Note, payload includes ID (1byte)
 
+
+		// Sub-stream overhead, in front of the message data (after the Id), so only in the first fragment.
+		static const i32_t off_Sub_Id   = 0;		// sub-stream
+		static const i32_t off_Sub_Dist = 4;		// sequence distance to last fragment of previous message on the sub-stream, 0 if none
+		static const i32_t hdr_Sub_Size = 8;
+
 		// Reliable newest packet overhead
 		static const i32_t off_RelNew_Seq  = 5;		// RelNew, sequence
 		static const i32_t off_RelNew_Num  = 9;		// RelNew, num groups
@@ -75,8 +189,72 @@ namespace Zerodelay
 		static const i32_t hdr_Ack_RelNew_Size = (off_Ack_Payload - off_Ack_RelNew_Seq);
 
 
+		// Selective ack overhead. Blocks are appended to the end of a Reliable_Ordered/Unreliable_Sequenced datagram (piggybacked)
+		// or form the payload of a standalone Ack_Selective packet. Layout: n x [chan | latest seq | mask] | n (1 byte)
+		static const i32_t sm_PiggyAckBit  = 0x80;		// set in type byte if selective ack blocks are appended at the end
+		static const i32_t off_Sack_Chan   = 0;			// 1 byte
+		static const i32_t off_Sack_Latest = 1;			// highest received sequence on channel
+		static const i32_t off_Sack_Mask   = 5;			// bit i set means latest-1-i was received
+		static const i32_t hdr_Sack_Size   = 9;
+		static const i32_t sm_SackMaskBits = 32;
+
+
+		// Fec parity overhead. Parity is xor of the packets from their type byte on. Always sent with normal header.
+		static const i32_t off_Fec_Chan   = 5;
+		static const i32_t off_Fec_Seq    = 6;		// first seq of group
+		static const i32_t off_Fec_Count  = 10;		// num packets in group
+		static const i32_t off_Fec_Flags  = 11;		// 1 if the packets have compact headers
+		static const i32_t off_Fec_LenXor = 12;		// xor of lengths of the packets (2 bytes)
+		static const i32_t off_Fec_Data   = 14;
+
+
+		// Redundant packet overhead. Newest message first, each older message is delta encoded against the one before it
+		// as runs of [num zeros | num literals | literals] of their xor. Always sent with normal header.
+		static const i32_t off_Red_ChanNFlags = 5;	// channel & relay bit, same as normal packet
+		static const i32_t off_Red_Seq  = 6;		// seq of newest message, the others count down from it
+		static const i32_t off_Red_Num  = 10;		// num messages
+		static const i32_t off_Red_Data = 11;		// n x [len (2 bytes) | encoded len (2 bytes) | encoded id & payload]
+		static const i32_t hdr_Red_Item_Size = 4;
+
+
+		// Ack redundant overhead
+		static const i32_t off_Ack_Red_Chan = 5;
+		static const i32_t off_Ack_Red_Seq  = 6;	// next seq to deliver, older ones are received or given up
+		static const i32_t hdr_Ack_Red_Size = 5;
+
+
+		// Mtu probe overhead. Probe is padded to the probed size, its ack has no padding.
+		static const i32_t off_Mtu_Size = 5;		// size of the probe datagram (2 bytes)
+		static const i32_t hdr_Mtu_Size = 2;
+
+
+		// Aggregate (coalesced) packet overhead. Multiple packets of one link in a single datagram.
+		// Each item is a packet without its linkId, so starting at the type byte.
+		static const i32_t off_Agg_Data = 5;			// n x [len (2 bytes) | packet from type byte on]
+		static const i32_t hdr_Agg_Item_Size = 2;
+
+
+		// Compact header, negotiated at connect. Only normal packets, selective acks and aggregates of them are sent compact.
+		// Layout: [short link id (2 bytes) | type, channel & flags (1 byte) | low 16 bits of seq (2 bytes) | id | payload].
+		// The compact bit is in the first byte, which is the lowest byte of the linkId in a normal header. Links that can use
+		// compact headers have that bit cleared in their linkId, so the first byte tells which header a datagram has.
+		static const u8_t  sm_CompactHdrBit = 0x80;
+		static const u8_t  sm_CompactPiggyAckBit = 0x40;	// replaces sm_PiggyAckBit
+		static const u32_t sm_CompactLinkIdMask = 0x3FFF;	// short link id is (linkId >> 8) & mask
+		static const u32_t sm_CompactMaxWindow = 1U<<15;	// half the range of the 16 bit sequence
+		static const i32_t sm_CompactKindShift = 6;		// top 2 bits of type byte: 0 other type (rest of byte), 1 reliable ordered, 2 unreliable sequenced
+		static const i32_t off_Cmp_Type = 2;				// lower 6 bits are channel & flags, same as off_Norm_ChanNFlags
+		static const i32_t hdr_Cmp_Generic_Size = off_Cmp_Type+1;
+		static const i32_t off_Cmp_Norm_Seq  = 3;
+		static const i32_t off_Cmp_Norm_Id   = 5;
+		static const i32_t off_Cmp_Norm_Data = 6;
+		static const i32_t off_Cmp_Agg_Data  = 3;
+
+
 		// Maximum channels in case of normal packet types
 		static const i32_t sm_NumChannels  = 8;
+		// Each channel has a sequence stream for ordered (sequenced) packets and one for unordered (unsequenced) packets
+		static const i32_t sm_NumStreams = sm_NumChannels*2;
 		
 
 	public:
@@ -85,19 +263,23 @@ namespace Zerodelay
 
 		// ------ Called from main thread -------
 
-		ESendCallResult addToSendQueue( u8_t id, const i8_t* data, i32_t len, EHeaderPacketType packetType, u8_t channel=0, bool relay=true, u32_t* sequence=nullptr, u32_t* numFragments=nullptr);
+		ESendCallResult addToSendQueue( u8_t id, const i8_t* data, i32_t len, EHeaderPacketType packetType, u8_t channel=0, bool relay=true, u32_t* sequence=nullptr, u32_t* numFragments=nullptr,
+										u32_t subStream=0, const i8_t* sharedPayload=nullptr ); // sharedPayload from allocSharedPayload is referenced instead of copied
 		void addReliableNewest( u8_t id, const i8_t* data, i32_t len, u32_t groupId, i8_t groupBit );
 		void blockAllUpcomingSends();
 		
-		// Always first call beginPoll, then repeatedly poll until no more packets, then endPoll
-		void beginPoll();
+		// Copy of data for sending the same message to multiple links, nullptr if not worth it for the type or size. Release after sending.
+		static const i8_t* allocSharedPayload( EHeaderPacketType packetType, const i8_t* data, i32_t len );
+
+		// Does not block the recv thread, call repeatedly until no more packets
 		bool poll(Packet& pack);
-		void endPoll();
 
 		// States usually set from upper laying connection
 		void markPendingDelete();
 		bool isPendingDelete() const { return m_IsPendingDelete; }
 		void setConnected(bool connected) { m_Connected = connected; }
+		void setCompactHeader() { m_CompactHdr = true; } // only if canUseCompactHeader, peer must support it
+		bool canUseCompactHeader() const { return (m_LinkId & sm_CompactHdrBit) == 0 && m_ReliableWindow <= sm_CompactMaxWindow; }
 		bool isConnected() const { return m_Connected; }
 
 		// If pinned, link will not be deleted from memory
@@ -107,89 +289,237 @@ namespace Zerodelay
 		void unpin();
 		void unpinWithLock();
 
+		// Sends all coalesced packets now. Can be called from any thread.
+		void flush(ISocket* socket);
+
 		u32_t id() const { return m_LinkId; }
 		bool areAllQueuesEmpty() const;
-		bool isSequenceDelivered(u32_t sequence, i8_t channel) const;
+		bool isSequenceDelivered(u32_t sequence, i32_t channel) const;
 
 		// Set to 0, to turn off. Default is off.
 		void simulatePacketLoss( u8_t percentage = 10 );						// Not thread safe, but only for debugging purposes so deliberately no atomic_int.
 		const EndPoint& getEndPoint() const { return m_EndPoint; }				// Set at beginning, can be queried by multiple threads.
 		i32_t getTimeSincePendingDelete() const;								// Is set when becomes pending delete which is thread safe, so this can be queried thread safe.
 
-		// TODO To be implemented
-		u32_t getLatency() const { return 40; }
+		// Round trip statistics in milliseconds, measured from acks. Can be queried from any thread.
+		u32_t getLatency() const { return m_SmoothedRtt; }
+		u32_t getLatencyVariance() const { return m_RttVariance; }
+		u32_t getRetransmitTimeout() const { return m_RetransmitTimeout; }
+
+		// Reliable data that is unacked or waits for room in the window, channel -1 is all. Bytes include unacked reliable newest data.
+		void getQueuedSend( i32_t channel, u32_t& bytesOut, u32_t& messagesOut ) const;
 
 	private:
 		// executed on send thread
-		void dispatchRelOrderedQueueIfLatencyTimePassed(u32_t deltaTime, ISocket* socket);
-		void dispatchReliableOrderedQueue(ISocket* socket);
-		void dispatchReliableNewestQueue(ISocket* socket);
+		i32_t getTimeUntilNextSend() const;	// retransmission or paced new data, returns -1 if nothing to send
+		void dispatchReliableOrderedQueue(ISocket* socket); // only resends fragments whose timer expired and sends new fragments that fit in window
+		void flushReliableBacklog(ISocket* socket);			// requires ReliableOrderedQueueMutex, moves fragments in window in flight
+		bool hasSendBudget(u8_t channel, i32_t len) const;	// requires ReliableOrderedQueueMutex, false if message does not fit in the link or channel budget
+
+		// retransmission timers, requires ReliableOrderedQueueMutex
+		void  setRetransmitTimer(reliableOrderedItem& item, i32_t dueTS);
+		i32_t getRetransmitKey(i32_t timeTS) const { return (i32_t)((u32_t)timeTS - (u32_t)m_RetransmitTimerBase); } // unsigned, wraps without overflow
+		i32_t getTimeUntilRetransmit(retransmitTimerMap::const_iterator it, i32_t timeNow) const { return it->first - getRetransmitKey( timeNow ); }
+		bool  hasRetransmitDue(i32_t timeNow) const { return !m_RetransmitTimers.empty() && getTimeUntilRetransmit( m_RetransmitTimers.begin(), timeNow ) <= 0; }
+
+		// congestion control, requires ReliableOrderedQueueMutex
+		i32_t getTimeUntilCanSend(u32_t numBytes, i32_t timeNow) const; // -1 if congestion window is full
+		bool  trySendReliable(u32_t numBytes, i32_t timeNow); // consumes pacer tokens if allowed to send
+		bool dispatchReliableNewestQueue(ISocket* socket);	// true if unacked data remains
+		void dispatchAcks(ISocket* socket);
 		void dispatchAckQueue(ISocket* socket);
+		void dispatchSelectiveAckQueue(ISocket* socket);	// only sends if acks could not be piggybacked on other data
 		void dispatchRelNewestAckQueue(ISocket* socket);
+		void dispatchRedundantAckQueue(ISocket* socket);
+		void dispatchCoalescedPackets(ISocket* socket);		// only flushes if coalesce delay passed
+		i32_t dispatchMtuProbe(ISocket* socket);			// returns time until it must be called again, -1 if never
+		void setMaxDatagramSize(i32_t size);
+
+		// executed on main and send thread
+		void sendDatagram( ISocket* socket, const i8_t* data, i32_t len, const i8_t* payload=nullptr, i32_t payloadLen=0 ); // coalesces if enabled, payload follows data
+		void sendWithAcks( ISocket* socket, const i8_t* data, i32_t len, const i8_t* payload=nullptr, i32_t payloadLen=0 ); // piggybacks pending selective acks
+		void sendPacket( ISocket* socket, const Packet& pack ) { sendDatagram( socket, pack.data, pack.len - pack.payloadLen, pack.payload, pack.payloadLen ); }
+		void sendCoalescedPackets( ISocket* socket ); // requires CoalesceMutex
+		i32_t getTimeUntilCoalesceDeadline() const;   // returns -1 if nothing coalesced
+		i32_t getMaxDatagramSize() const { return m_FragmentSize + off_Norm_Data; }
+		bool isCompactHeader( const i8_t* buff ) const { return (m_LinkId & sm_CompactHdrBit) == 0 && ((u8_t)buff[0] & sm_CompactHdrBit) != 0; }
+		bool isCompactLinkId( const i8_t* buff ) const; // short link id in compact header matches
+		void writeSequence( Packet& pack, u32_t seq ) const;
+		i32_t writeSelectiveAcks( i8_t* buff, i32_t buffSize );
 
 		// executed on recv thread
-		void recvData( const i8_t* buff, i32_t len );
-		void addAckToAckQueue( i8_t channel, u32_t seq );
-		void receiveReliableOrdered(u32_t linkId, const i8_t * buff, i32_t rawSize);
-		void receiveUnreliableSequenced(u32_t linkId, const i8_t * buff, i32_t rawSize);
+		void recvData( const i8_t* buff, i32_t len ); // buff must be a PacketPool buffer, received packets reference slices of it
+		void recvPacket( u32_t linkId, EHeaderPacketType type, const i8_t* buff, i32_t rawSize );
+		void receiveAggregate( u32_t linkId, const i8_t* buff, i32_t rawSize );
+		void addAckToAckQueue( i32_t channel, u32_t seq );
+		void scheduleAcks(); // after an ack became pending
+		void receiveSelectiveAcks(const i8_t* buff, i32_t rawSize);
+		bool removeAckedFragment(i32_t channel, u32_t seq, i32_t& rttSample); // requires ReliableOrderedQueueMutex
+		bool detectLostFragments(i32_t channel, i32_t timeNow);				 // requires ReliableOrderedQueueMutex, true if any is to be resent
+		void receiveReliable(u32_t linkId, EHeaderPacketType type, const i8_t * buff, i32_t rawSize); // acks it, unless it cannot be accepted now
+		void deliverReliableOrdered(i32_t stream);
+		void deliverReliableUnordered(i32_t stream, u32_t seq);
+		void releaseReliable(i32_t stream, Packet& pack, u32_t firstSeq, u32_t lastSeq); // to game thread, unless a sub-stream message must wait
+		bool isSubStreamReleased(i32_t stream, u32_t lastSeq) const;
+		void linkSubStream(Packet& firstFragment, i32_t stream, u8_t channel, u32_t subStream, u32_t firstSeq, u32_t lastSeq); // requires ReliableOrderedQueueMutex
+		void relayFromRecvThread(Packet& pack); // user packets with relay bit are queued for relay by the receive thread, clears the bit if so
+		recvFragmentSlot* getUnreliableFragment(i32_t stream, u32_t seq);
+		void receiveUnreliable(u32_t linkId, EHeaderPacketType type, const i8_t * buff, i32_t rawSize, bool recovered=false); // recovered is not kept for fec
+		void addToFecGroup(const Packet& pack, u8_t channel, u32_t seq);
+		void sendFecParity(u8_t channel);
+		ESendCallResult sendRedundant(u8_t id, const i8_t* data, i32_t len, u8_t channel, bool relay); // main thread
+		void receiveRedundant(u32_t linkId, const i8_t* buff, i32_t rawSize);
+		void receiveAckRedundant(const i8_t* buff, i32_t rawSize);
+		void receiveFecParity(u32_t linkId, const i8_t* buff, i32_t rawSize);
 		void receiveReliableNewest(u32_t linkId, const i8_t* buff, i32_t rawSize);
 		void receiveAck(const i8_t* buff, i32_t rawSize);
 		void receiveAckRelNewest(const i8_t* buff, i32_t rawSize);
+		void updateRoundTripTime( i32_t sampleMs );
+		void receiveMtuProbe(const i8_t* buff, i32_t rawSize);
+		void receiveMtuProbeAck(const i8_t* buff, i32_t rawSize);
+
+		// retransmit ring
+		reliableOrderedItem* getRetransmitSlot(i32_t channel, u32_t seq);
+		const reliableOrderedItem* getRetransmitSlot(i32_t channel, u32_t seq) const;
 
 		// serialize functions
-		static void serializeNormalPacket( std::vector<Packet>& packs, u32_t linkId, EHeaderPacketType packetType, u8_t dataId, const i8_t* data, i32_t len, i32_t fragmentSize, i8_t channel, bool relay );
+		static void serializeNormalPacket( std::vector<Packet>& packs, u32_t linkId, EHeaderPacketType packetType, u8_t dataId, const i8_t* data, i32_t len, i32_t fragmentSize, i8_t channel, bool relay, bool compact,
+										   const i8_t* sharedPayload=nullptr ); // if set, data is sharedPayload and fragments reference it
+		static void releaseSendPacket( const Packet& pack );
+		static void serializeCompactLinkId( i8_t* buff, u32_t linkId );
 		static bool deserializeGenericHdr(const i8_t* buff, i32_t rawSize, u32_t& linkIdOut, EHeaderPacketType& packetType);
-		static bool deserializeNormalHdr(const i8_t* buff, i32_t rawSize, i8_t& channOut, bool& relayOut, u32_t& seqOut, bool& firstFragment, bool& lastFragment );
-		static void createNormalPacket(Packet& pack, const i8_t* buff, i32_t dataSize, u32_t linkId, i8_t channel, bool relay, EHeaderPacketType type);
-		static void defragmentPacket(Packet& pack, u32_t beginSeq, u32_t lastSeq, std::map<u32_t, Packet>& fragments); 
-		static bool tryReassembleBigPacket(Packet& finalPack, std::map<u32_t, Packet>& fragments, u32_t seq, u32_t& beginSeq, u32_t& lastSeq);
+		static EHeaderPacketType deserializeCompactType( i8_t typeByte );
+		static bool deserializeNormalHdr(const i8_t* buff, i32_t rawSize, bool compact, i32_t& channOut, bool& relayOut, u32_t& seqOut, bool& firstFragment, bool& lastFragment ); // compact seq is only the low 16 bits
+		static void createNormalPacket(Packet& pack, const i8_t* recvBuffer, const i8_t* buff, i32_t dataSize, u32_t linkId, i8_t channel, bool relay, EHeaderPacketType type);
+		static void defragmentPacket(Packet& pack, std::vector<Packet>& fragments); // releases and clears the fragments
+		static i32_t encodeDelta(i8_t* out, i32_t outSize, const i8_t* data, i32_t len, const i8_t* ref, i32_t refLen); // -1 if does not fit
+		static bool decodeDelta(i8_t* out, i32_t len, const i8_t* enc, i32_t encLen, const i8_t* ref, i32_t refLen);
+
+		static i32_t getStream( EHeaderPacketType type, i32_t channel );
 
 		// sequence newer support
 		static bool isSequenceNewer( u32_t incoming, u32_t having );
+		static u32_t expandSequence( u32_t truncated, u32_t reference ); // sequence with these low 16 bits closest to reference
 
 
 		// manager ptrs
 		RecvNode* m_RecvNode;
 		// state
 		volatile bool m_Connected; // if upper laying connection is healty connection, this is set. If no longer healthy, it becomes a pending delete link.
+		std::atomic_bool m_CompactHdr; // send compact headers, receiving them does not depend on this
 		u32_t m_LinkId;
 		EndPoint m_EndPoint;
 		std::atomic_bool m_BlockNewSends;
-		// send queues
-		std::deque<Packet>  m_RetransmitQueue_reliable[sm_NumChannels];
+		// send queues, reliable per stream
+		std::vector<reliableOrderedItem> m_RetransmitRing_reliable[sm_NumStreams];	// indexed by seq & (window-1), allocated on first use
+		std::deque<Packet> m_SendBacklog_reliable[sm_NumStreams];						// sequenced, but waiting for room in window
+		u32_t m_RetransmitBase_reliable[sm_NumStreams];								// oldest unacked sequence
+		u32_t m_RetransmitNext_reliable[sm_NumStreams];								// next sequence that goes in flight
+		u32_t m_HighestAcked_reliable[sm_NumStreams];
+		i32_t m_NewestAckedSendTS;														// send time of most recently sent fragment that got acked
+		u32_t m_ReliableWindow;
+		retransmitTimerMap m_RetransmitTimers;
+		i32_t m_RetransmitTimerBase;	// timer keys are relative to this
+		// congestion control (all guarded by ReliableOrderedQueueMutex)
+		class ICongestionControl* m_CongestionControl; // nullptr if turned off
+		Pacer m_Pacer;
+		u32_t m_BytesInFlight;
+		std::atomic_bool m_HasReliableBacklog;
+		// send budgets of user messages, [0] is the link then per channel, 0 is unlimited (queued guarded by ReliableOrderedQueueMutex)
+		u32_t m_SendBudgetBytes[sm_NumChannels+1];
+		u32_t m_SendBudgetMessages[sm_NumChannels+1];
+		u32_t m_QueuedBytes[sm_NumChannels];		// ordered and unordered streams of a channel together
+		u32_t m_QueuedMessages[sm_NumChannels];
 		std::map<u32_t, reliableNewestDataGroup> m_SendQueue_reliable_newest;
-		// recv queues
-		std::deque<Packet>	m_RecvQueue_unreliable_sequenced[sm_NumChannels];
-		std::deque<Packet>	m_RecvQueue_reliable_newest;
-		std::map<u32_t, std::pair<Packet, u32_t>> m_RecvQueue_reliable_order[sm_NumChannels]; // packet/num fragments
-		// fragment buffers
-		std::map<u32_t, Packet>		m_Ureliable_fragments[sm_NumChannels];
-		std::map<u32_t, Packet>		m_Reliable_fragments[sm_NumChannels];
-		// ack queue
-		std::deque<u32_t> m_AckQueue[sm_NumChannels];
-		// sequencers
-		u32_t m_SendSeq_reliable[sm_NumChannels];
-		u32_t m_SendSeq_unreliable[sm_NumChannels];
-		u32_t m_RecvSeq_unreliable[sm_NumChannels];
-		volatile u32_t m_RecvSeq_reliable[sm_NumChannels];			// game thread increments this value while recv thread checks this value for incoming packets to block discard older packets early on
+		std::atomic<u32_t> m_QueuedBytes_reliable_newest;
+		// recv queues, recv thread produces, game thread consumes
+		SpscRing<Packet, sm_RecvRingSize_reliable_order>  m_RecvRing_reliable_order;	// all reliable streams
+		SpscRing<Packet, sm_RecvRingSize_unreliable>	  m_RecvRing_unreliable_sequenced;
+		SpscRing<Packet, sm_RecvRingSize_reliable_newest> m_RecvRing_reliable_newest;
+		// reorder buffers, only touched by recv thread
+		std::vector<recvFragmentSlot> m_ReorderRing_reliable[sm_NumStreams];	// indexed by seq & (window-1), allocated on first use
+		std::vector<Packet> m_Assembly_reliable[sm_NumStreams];				// in order fragments of a message that is not complete yet
+		std::atomic<i32_t> m_NumReorderPackets; // total in the reorder rings
+		// fragment buffers, only touched by recv thread
+		std::vector<recvFragmentSlot> m_FragmentRing_unreliable[sm_NumStreams];	// indexed by seq & (sm_UnreliableFragmentWindow-1), allocated on first use
+		std::vector<Packet> m_FragmentScratch;
+		// sub-streams, messages are chained to the previous message of their sub-stream by sequence, only touched by recv thread
+		std::map<u32_t, Packet> m_SubStreamHeld[sm_NumChannels];		// by last seq, complete but waiting for previous message
+		std::map<u32_t, u32_t> m_SubStreamWaiting[sm_NumChannels];		// last seq of previous message to last seq of held message
+		// ack queue (only for sequences that fall outside the selective ack window)
+		std::deque<u32_t> m_AckQueue[sm_NumStreams];
+		// selective acks
+		u32_t m_SackLatest[sm_NumStreams];
+		u32_t m_SackMask[sm_NumStreams];
+		bool  m_SackValid[sm_NumStreams];
+		bool  m_SackDirty[sm_NumStreams];
+		std::vector<sackBlock> m_SackQueue;	// sent before the blocks above
+		std::atomic_bool m_SackPending;
+		// coalescing of small packets into a single datagram
+		i8_t  m_CoalesceBuffer[ZERODELAY_BUFF_SIZE];
+		i32_t m_CoalesceLen;
+		i32_t m_CoalesceCount;
+		i32_t m_CoalesceDeadlineTS;
+		bool  m_CoalesceCompact;
+		// sequencers, per stream
+		u32_t m_SendSeq_reliable[sm_NumStreams];
+		u32_t m_SendSeq_unreliable[sm_NumStreams];
+		std::map<u32_t, u32_t> m_SubStreamLastSeq[sm_NumChannels];	// sub-stream to last seq of its newest message, pruned once acked
+		u32_t m_SubStreamPruneSize[sm_NumChannels];					// prune when the map grows beyond this
+		// forward error correction, send groups are only touched by main thread, history only by recv thread
+		u32_t m_FecGroupSize[sm_NumChannels];
+		fecSendGroup m_FecSend[sm_NumChannels];
+		std::vector<fecRecvSlot> m_FecHistory[sm_NumChannels];		// indexed by seq & (sm_FecHistorySize-1), allocated on first parity
+		// input redundancy, send history is only touched by main thread
+		u32_t m_Redundancy[sm_NumChannels];									// num previous messages that are repeated
+		std::deque<redundantSendItem> m_RedundantHistory[sm_NumChannels];	// unacked messages, newest at back
+		u32_t m_SendSeq_redundant[sm_NumChannels];
+		std::atomic<u32_t> m_RedundantAcked[sm_NumChannels];				// next seq the remote expects, set by recv thread
+		std::atomic<u32_t> m_RecvSeq_redundant[sm_NumChannels];				// next to deliver, written by recv thread, acked by send thread
+		std::atomic_bool m_RedundantAckPending[sm_NumChannels];
+		u32_t m_RecvSeq_unreliable[sm_NumStreams];
+		u32_t m_RecvSeq_reliable[sm_NumStreams];					// next to deliver to the game thread, only touched by recv thread
 		volatile u32_t m_RecvSeq_reliable_newest;					// volatile, because updated in recv thread, but used for sending ack sequence in send thread
 		u32_t m_SendSeq_reliable_newest;
 		u32_t m_RecvSeq_reliable_newest_ack;
+		std::atomic_bool m_RelNewestAckPending;
+		std::atomic_bool m_AcksScheduled;							// cleared by send thread before it sends the pending acks
+		// send thread timers, guarded by the timer mutex of RecvNode
+		TimerWheel::Timer m_Timers[(i32_t)ELinkTimer::Count];
 		// threading
 		mutable std::mutex m_ReliableOrderedQueueMutex;
 		mutable std::mutex m_ReliableNewestQueueMutex;
-		mutable std::mutex m_RecvQueuesMutex;
 		mutable std::mutex m_AckMutex;
+		mutable std::mutex m_CoalesceMutex;
+		std::mutex m_SendMutex;	// addToSendQueue is called by main thread and by receive threads that relay
 		// statistics
-		u32_t m_RetransmitWaitingTime;
+		bool  m_HasRttSample;							// only touched by recv thread
+		float m_SmoothedRttF;							// only touched by recv thread
+		float m_RttVarianceF;							// only touched by recv thread
+		std::atomic<u32_t> m_SmoothedRtt;
+		std::atomic<u32_t> m_RttVariance;
+		std::atomic<u32_t> m_RetransmitTimeout;
 		u8_t  m_PacketLossPercentage;
-		u32_t m_FragmentSize;
+		std::atomic<u32_t> m_FragmentSize;	// payload of a normal packet, follows probed datagram size
+		// datagram size probing, only touched by send thread
+		i32_t m_MtuSize;					// largest datagram size that is known to arrive
+		i32_t m_MtuSearchHigh;				// smallest size that did not arrive (or max+1)
+		i32_t m_MtuProbeSize;				// outstanding probe, 0 if none
+		i32_t m_MtuProbeCount;				// times the outstanding probe was sent
+		i32_t m_MtuProbeTS;
+		i32_t m_MtuSearchDoneTS;
+		std::atomic<i32_t> m_MtuProbeAckSize;	// set by recv thread, 0 if none
 		// pinned
 		u32_t m_PinnedCount;
+		// receive shard (thread) that owns the link, -1 until its first datagram arrives
+		i32_t m_RecvShard;
+		// datagram that is being processed by recvData (only valid during the call)
+		const i8_t* m_RecvBuffer;
+		bool m_RecvCompact;
 		// on delete
 		std::mutex m_PendingDeleteMutex;
 		volatile bool m_IsPendingDelete; // Set from main thread, queried by recv thread
-		clock_t m_MarkDeleteTS;
+		i32_t m_MarkDeleteTS;
 
 		friend class RecvNode;
 	};
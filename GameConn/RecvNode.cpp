@@ -6,6 +6,7 @@
 #include "Platform.h"
 #include "ConnectionNode.h"
 #include "Util.h"
+#include "PacketPool.h"
 
 #include <cassert>
 #include <chrono>
@@ -15,14 +16,27 @@ namespace Zerodelay
 {
 	RecvNode::RecvNode(u32_t sendRelNewestIntervalMs, u32_t ackAggregateTimeMs):
 		m_IsClosing(false),
+		m_Socket(nullptr),
 		m_SendRelNewestIntervalMs(sendRelNewestIntervalMs),
 		m_AckAggregateTimeMs(ackAggregateTimeMs),
-		m_Socket(nullptr),
-		m_RecvThread(nullptr),
+		m_ReliableWindow(RUDPLink::sm_DefaultReliableWindow),
+		m_CoalesceDelayMs(2),
+		m_LowLatency(false),
+		m_CongestionControl(ECongestionControl::None),
+		m_NumRecvThreads(1),
 		m_SendThread(nullptr),
+		m_TimerWheel(Util::timeNow()),
+		m_SendThreadSleeping(false),
+		m_SendThreadWakeTS(0),
 		m_ListPinned(0)
 	{
 		m_CaptureSocketErrors = true;
+		for (auto& groupSize : m_FecGroupSize) groupSize = 0;
+		for (auto& redundancy : m_Redundancy) redundancy = RUDPLink::sm_DefaultRedundancy;
+		for (auto& budget : m_SendBudgetBytes) budget = 0;
+		for (auto& budget : m_SendBudgetMessages) budget = 0;
+		m_SendBudgetBytes[0] = RUDPLink::sm_DefaultSendBudgetBytes;
+		m_SendBudgetMessages[0] = RUDPLink::sm_DefaultSendBudgetMessages;
 	}
 
 	RecvNode::~RecvNode()
@@ -38,25 +52,38 @@ namespace Zerodelay
 		{
 			m_Socket->close();
 		}
-		if ( m_RecvThread && m_RecvThread->joinable() )
+		for ( auto& shard : m_Shards )
+		{
+			if ( shard.socket != m_Socket ) shard.socket->close();
+		}
+		wakeSendThread();
+		for ( auto& shard : m_Shards )
 		{
-			m_RecvThread->join();
+			if ( shard.thread && shard.thread->joinable() )
+			{
+				shard.thread->join();
+			}
+			delete shard.thread;
 		}
 		if ( m_SendThread && m_SendThread->joinable() )
 		{
 			m_SendThread->join();
 		}
-		delete m_RecvThread;
 		delete m_SendThread;
-		for ( auto& kvp : m_OpenLinksMap )
+		for ( auto link : m_OpenLinksList )
 		{
-			delete kvp.second;
+			delete link;
+		}
+		for ( auto& shard : m_Shards )
+		{
+			if ( shard.socket != m_Socket ) delete shard.socket;
 		}
 		delete m_Socket;
 		// reset state
 		Platform::log("RecvNode reset called, num links %d.", (i32_t)m_OpenLinksMap.size());
-		m_RecvThread = nullptr;
+		m_Shards.clear();
 		m_SendThread = nullptr;
+		m_TimerWheel.clear( Util::timeNow() );
 		m_OpenLinksMap.clear();
 		m_OpenLinksList.clear();
 		m_Socket = nullptr;
@@ -80,47 +107,111 @@ namespace Zerodelay
 	{
 		if (m_Socket)
 			return true; // already opened
+		// an ephemeral port (0) is only known after bind, so that gets a single socket
+		u32_t numShards = (port != 0 ? m_NumRecvThreads : 1);
 		if (!m_Socket) 
 			m_Socket = ISocket::create();
 		if (!m_Socket)
 			return false;
-		if (!m_Socket->open())
+		if (!m_Socket->open(IPProto::Ipv4, false, numShards > 1))
 			return false;
 		if (!m_Socket->bind(port))
 			return false;
+		m_Shards.resize(1);
+		m_Shards[0].socket = m_Socket;
+		m_Shards[0].thread = nullptr;
+		for (u32_t i=1; i<numShards; ++i)
+		{
+			RecvShard shard;
+			shard.socket = ISocket::create();
+			shard.thread = nullptr;
+			if ( !shard.socket || !shard.socket->open(IPProto::Ipv4, false, true) || !shard.socket->bind(port) )
+			{
+				Platform::log("WARNING: Could only open %d of %d receive sockets on port %d.", i, numShards, port);
+				delete shard.socket;
+				break;
+			}
+			m_Shards.emplace_back( shard );
+		}
 		return true;
 	}
 
+	template <typename Callback>
+	void RecvNode::forEachLink(const EndPoint* specific, bool exclude, bool /*connected*/, u32_t& linkCount, const Callback& cb)
+	{
+		// receive threads add links while the list is in use, so take a snapshot under the lock, the pin keeps them from being deleted
+		static thread_local std::vector<RUDPLink*> snapshot; // reused, keeps its capacity
+		snapshot.clear();
+		{
+			std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
+			m_ListPinned++;
+			linkCount = (u32_t) m_OpenLinksList.size();
+			if ( specific && !exclude )
+			{
+				RUDPLink* link = m_OpenLinksMap.find( *specific );
+				if ( link )
+				{
+					snapshot.emplace_back( link );
+				}
+			}
+			else
+			{
+				for ( auto it : m_OpenLinksList )
+				{
+					if ( !specific || it->getEndPoint() != *specific )
+					{
+						snapshot.emplace_back( it );
+					}
+				}
+			}
+		}
+		for ( auto it : snapshot )
+		{
+			cb( it );
+		}
+		unpinList();
+	}
+
 	ESendCallResult RecvNode::send(u8_t id, const i8_t* data,i32_t len, const EndPoint* specific, bool exclude, EHeaderPacketType type,
-								   u8_t channel, bool relay, std::vector<ZAckTicket>* deliveryTraceOut)
+								   u8_t channel, bool relay, std::vector<ZAckTicket>* deliveryTraceOut, u32_t subStream)
 	{
-		assert( type == EHeaderPacketType::Reliable_Ordered || type == EHeaderPacketType::Unreliable_Sequenced );
-		if ( !(type == EHeaderPacketType::Reliable_Ordered || type == EHeaderPacketType::Unreliable_Sequenced) )
+		bool bValidType = type == EHeaderPacketType::Reliable_Ordered || type == EHeaderPacketType::Unreliable_Sequenced ||
+						  type == EHeaderPacketType::Reliable_Unordered || type == EHeaderPacketType::Unreliable ||
+						  type == EHeaderPacketType::Reliable_SubStream || type == EHeaderPacketType::Unreliable_Redundant;
+		assert( bValidType );
+		if ( !bValidType )
 		{
 			m_CoreNode->setCriticalError(ECriticalError::InvalidLogic, ZERODELAY_FUNCTION_LINE);
 			return ESendCallResult::InternalError;
 		}
 		u32_t listCount;
 		ESendCallResult sendResult = ESendCallResult::NotSent;
+		const i8_t* sharedPayload = nullptr;
+		bool bSharedChecked = false;
 		forEachLink( specific, exclude, true, listCount, [&] (RUDPLink* link)
 		{
+			// payload is built once if the message goes to multiple links
+			if ( !bSharedChecked )
+			{
+				bSharedChecked = true;
+				if ( listCount > 1 && (!specific || exclude) ) sharedPayload = RUDPLink::allocSharedPayload( type, data, len );
+			}
 			ESendCallResult individualResult;
 			if (deliveryTraceOut)
 			{
-				u32_t sequence;
-				u32_t numFragments;
-				individualResult = link->addToSendQueue( id, data, len, type, channel, relay, &sequence, &numFragments );
-				Util::addTraceCallResult(deliveryTraceOut, link->getEndPoint(), ETraceCallResult::Tracking, sequence, numFragments, channel);
+				u32_t sequence = 0;
+				u32_t numFragments = 0;
+				individualResult = link->addToSendQueue( id, data, len, type, channel, relay, &sequence, &numFragments, subStream, sharedPayload );
+				ETraceCallResult traceResult = individualResult == ESendCallResult::WouldBlock ? ETraceCallResult::WouldBlock : ETraceCallResult::Tracking;
+				Util::addTraceCallResult(deliveryTraceOut, link->getEndPoint(), traceResult, sequence, numFragments, channel);
 			}
 			else
 			{
-				individualResult = link->addToSendQueue( id, data, len, type, channel, relay );
-			}
-			if ( sendResult == ESendCallResult::NotSent && individualResult == sendResult )
-			{
-				sendResult = ESendCallResult::Succes;
+				individualResult = link->addToSendQueue( id, data, len, type, channel, relay, nullptr, nullptr, subStream, sharedPayload );
 			}
+			sendResult = Util::combineSendResults( sendResult, individualResult );
 		});
+		PacketPool::release( sharedPayload );
 		if (sendResult == ESendCallResult::NotSent && !exclude && listCount == 1)
 		{
 			Platform::log("WARNING: Data with id %d was not sent to anyone.", id);
@@ -158,10 +249,9 @@ namespace Zerodelay
 	class RUDPLink* RecvNode::getLinkAndPinIt(const EndPoint& endpoint) const
 	{
 		std::lock_guard<std::mutex> lock(m_OpenLinksMutex); // pin requries this lock
-		auto it = m_OpenLinksMap.find(endpoint);
-		if ( it != m_OpenLinksMap.end() )
+		RUDPLink* link = m_OpenLinksMap.find(endpoint);
+		if ( link )
 		{
-			RUDPLink* link = it->second;
 			link->pin();
 			return link;
 		}
@@ -189,26 +279,108 @@ namespace Zerodelay
 
 	void RecvNode::unpinList()
 	{
+		std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
 		m_ListPinned--;
 	}
 
+	void RecvNode::setFecGroupSize(u8_t channel, u32_t groupSize)
+	{
+		if ( channel >= RUDPLink::sm_NumChannels )
+		{
+			Platform::log("WARNING: Invalid channel %d for fec, max is %d.", channel, RUDPLink::sm_NumChannels-1);
+			return;
+		}
+		m_FecGroupSize[channel] = Util::min( groupSize, RUDPLink::sm_FecMaxGroupSize );
+	}
+
+	void RecvNode::setRedundancy(u8_t channel, u32_t numPrevious)
+	{
+		if ( channel >= RUDPLink::sm_NumChannels )
+		{
+			Platform::log("WARNING: Invalid channel %d for redundancy, max is %d.", channel, RUDPLink::sm_NumChannels-1);
+			return;
+		}
+		m_Redundancy[channel] = Util::min( numPrevious, RUDPLink::sm_MaxRedundancy );
+	}
+
+	void RecvNode::setSendBudget(i32_t channel, u32_t maxBytes, u32_t maxMessages)
+	{
+		if ( channel < -1 || channel >= RUDPLink::sm_NumChannels )
+		{
+			Platform::log("WARNING: Invalid channel %d for send budget, max is %d.", channel, RUDPLink::sm_NumChannels-1);
+			return;
+		}
+		m_SendBudgetBytes[channel+1] = maxBytes;
+		m_SendBudgetMessages[channel+1] = maxMessages;
+	}
+
 	void RecvNode::simulatePacketLoss(i32_t percentage)
 	{
 		std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
-		for (auto& kvp : m_OpenLinksMap )
+		for (auto link : m_OpenLinksList )
 		{
-			if ( !kvp.second->isPendingDelete() )
+			if ( !link->isPendingDelete() )
 			{
-				kvp.second->simulatePacketLoss( percentage );
+				link->simulatePacketLoss( percentage );
 			}
 		}
 	}
 
+	void RecvNode::setReliableWindow(u32_t numFragments)
+	{
+		// round up to power of two, so that a sequence maps to a slot with a mask
+		u32_t window = 1;
+		while ( window < numFragments && window < (1U<<30) ) window <<= 1;
+		m_ReliableWindow = window;
+	}
+
+	void RecvNode::flush()
+	{
+		u32_t linkCount;
+		forEachLink( nullptr, false, false, linkCount, [this](RUDPLink* link)
+		{
+			link->flush( m_Socket );
+		});
+	}
+
+	void RecvNode::wakeSendThread()
+	{
+		std::lock_guard<std::mutex> lock(m_TimerMutex);
+		m_SendThreadCv.notify_one();
+	}
+
+	void RecvNode::scheduleLink(RUDPLink* link, ELinkTimer timer, i32_t delayMs)
+	{
+		std::lock_guard<std::mutex> lock(m_TimerMutex);
+		TimerWheel::Timer& linkTimer = link->m_Timers[(i32_t)timer];
+		i32_t dueTS = Util::timeNow() + delayMs;
+		// the send thread reschedules when an earlier one expires
+		if ( TimerWheel::isScheduled( linkTimer ) && (linkTimer.dueTS - dueTS) <= 0 )
+			return;
+		m_TimerWheel.schedule( linkTimer, dueTS );
+		if ( m_SendThreadSleeping && (dueTS - m_SendThreadWakeTS) < 0 )
+		{
+			m_SendThreadCv.notify_one();
+		}
+	}
+
+	void RecvNode::cancelLinkTimers(RUDPLink* link)
+	{
+		std::lock_guard<std::mutex> lock(m_TimerMutex);
+		for (auto& timer : link->m_Timers)
+		{
+			m_TimerWheel.cancel( timer );
+		}
+	}
+
 	void RecvNode::startThreads()
 	{
-		if ( m_RecvThread )
+		if ( m_SendThread )
 			return;
-		m_RecvThread = new std::thread( [this] () { recvThread(); } );
+		for (i32_t i=0; i<(i32_t)m_Shards.size(); ++i)
+		{
+			m_Shards[i].thread = new std::thread( [this, i] () { recvThread( i ); } );
+		}
 		m_SendThread = new std::thread( [this] () { sendThread(); } );
 	}
 
@@ -238,21 +410,54 @@ namespace Zerodelay
 		return false;
 	}
 
-	void RecvNode::recvThread()
+	bool RecvNode::getLatency(const ZEndpoint& ztp, u32_t& latencyOut, u32_t& varianceOut) const
+	{
+		RUDPLink* link = getLinkAndPinIt( Util::toEtp(ztp) );
+		if ( link )
+		{
+			latencyOut  = link->getLatency();
+			varianceOut = link->getLatencyVariance();
+			unpinLink( link );
+			return true;
+		}
+		return false;
+	}
+
+	bool RecvNode::getQueuedSend(const ZEndpoint& ztp, i32_t channel, u32_t& bytesOut, u32_t& messagesOut) const
+	{
+		RUDPLink* link = getLinkAndPinIt( Util::toEtp(ztp) );
+		if ( link )
+		{
+			link->getQueuedSend( channel, bytesOut, messagesOut );
+			unpinLink( link );
+			return true;
+		}
+		return false;
+	}
+
+	void RecvNode::recvThread(i32_t shardIdx)
 	{
-		EndPoint endPoint;
+		ISocket* socket = m_Shards[shardIdx].socket;
+		// one pooled buffer per datagram, +1 so that a payload can be zero terminated for logging
+		const i32_t kSlotSize = ZERODELAY_BUFF_RECV_SIZE + 1;
+		Datagram datagrams[ISocket::sm_MaxBatchSize];
+		for (auto& dg : datagrams)
+		{
+			dg.data = PacketPool::alloc( kSlotSize );
+		}
 		i32_t lastUpdateTS = 0;
 		while ( !m_IsClosing )
 		{
 			// non blocking sockets for testing purposes
-			if ( !m_Socket->isBlocking() )
+			if ( !socket->isBlocking() )
 			{
 				std::this_thread::sleep_for(std::chrono::milliseconds(5));
 			}
 
-			i8_t buff[ZERODELAY_BUFF_RECV_SIZE];
-			i32_t rawSize = ZERODELAY_BUFF_RECV_SIZE;
-			ERecvResult eResult = m_Socket->recv( buff, rawSize, endPoint );
+			// drain up to max batch size datagrams per wakeup
+			for (auto& dg : datagrams) dg.len = ZERODELAY_BUFF_RECV_SIZE;
+			i32_t numDatagrams = ISocket::sm_MaxBatchSize;
+			ERecvResult eResult = socket->recvBatch( datagrams, numDatagrams );
 
 			// discard socket interrupt 'errors' if closing
 			if ( m_IsClosing )
@@ -261,7 +466,7 @@ namespace Zerodelay
 			// do occasional administration updates k times/sec
 			if (Util::getTimeSince(lastUpdateTS) >= 200)
 			{
-				updatePendingDeletes();
+				updatePendingDeletes( shardIdx );
 				lastUpdateTS = Util::timeNow();
 			}
 
@@ -270,7 +475,7 @@ namespace Zerodelay
 				// optionally capture the socket errors
 				if ( m_CaptureSocketErrors )
 				{
-					i32_t err = m_Socket->getUnderlayingSocketError();
+					i32_t err = socket->getUnderlayingSocketError();
 					if ( err != 0 )
 					{
 						Platform::log("WARNING: Socket error in recvPoint %d.", err);
@@ -279,112 +484,227 @@ namespace Zerodelay
 				continue;
 			}
 
-			if ( rawSize < RUDPLink::hdr_Generic_Size )
+			for (i32_t i=0; i<numDatagrams; ++i)
 			{
-				Platform::log("WARNING: Incoming packet smaller than hdr size, dropping packet.");
-				continue;
+				recvDatagram( shardIdx, datagrams[i].data, datagrams[i].len, datagrams[i].endPoint );
+				// received packets reference the buffer instead of copying from it, so only reuse it if none did
+				if ( PacketPool::isShared( datagrams[i].data ) )
+				{
+					PacketPool::release( datagrams[i].data );
+					datagrams[i].data = PacketPool::alloc( kSlotSize );
+				}
 			}
+			relayPackets( shardIdx );
+		}
 
-			// get link, even if is pending delete
-			RUDPLink* link = getLink (endPoint, true);
-			if ( link && link->isPendingDelete() )
+		for (auto& dg : datagrams)
+		{
+			PacketPool::release( dg.data );
+		}
+		for (auto& relay : m_Shards[shardIdx].relays)
+		{
+			PacketPool::release( relay.pack.buffer );
+		}
+		m_Shards[shardIdx].relays.clear();
+	}
+
+	bool RecvNode::queueRelay(i32_t shardIdx, const Packet& pack, RUDPLink* source)
+	{
+		// client-server only, in p2p everyone is connected to everyone already
+		if ( !m_CoreNode->isListening() || m_CoreNode->isP2P() || !source->isConnected() || shardIdx < 0 )
+			return false;
+		PacketPool::addRef( pack.buffer );
+		m_Shards[shardIdx].relays.push_back( { pack, source, nullptr } );
+		return true;
+	}
+
+	void RecvNode::relayPackets(i32_t shardIdx)
+	{
+		auto& relays = m_Shards[shardIdx].relays;
+		if ( relays.empty() )
+			return;
+		// sent outside the lock on a snapshot of the links, so that other shards and the game thread are not held up
+		u32_t linkCount = 0;
+		u32_t numBlocked = 0;
+		bool bSharedChecked = false;
+		forEachLink( nullptr, false, true, linkCount, [&] (RUDPLink* link)
+		{
+			if ( !bSharedChecked )
 			{
-				// Only report messages after the link has stopped lingering, otherwise we may end up with many messages that were just send after disconnect
-				// or if disconnect is re-transmitted very often due to high retransmission rate in reliable ordered protocol.
-				i8_t norm_id  = -1;
-				if ( rawSize > RUDPLink::off_Norm_Id ) norm_id = buff[RUDPLink::off_Norm_Id];
-				buff[rawSize] = '\0';
-
-				i32_t timeSincePenDelete = link->getTimeSincePendingDelete();
-				if ( timeSincePenDelete >= RUDPLink::sm_MaxLingerTimeMs )
-				{ 
-					Platform::log("WARNING: Ignoring data for link %s (id %d) as is pending delete and more than %dms lingered (%dms). HdrId: %d dataId: %d payload: %s.",
-								  link->getEndPoint().toIpAndPort().c_str(), link->id(), RUDPLink::sm_MaxLingerTimeMs, timeSincePenDelete, buff[RUDPLink::off_Type], norm_id, buff);
-					continue;
-				}
-				else
+				bSharedChecked = true;
+				if ( linkCount > 2 )
 				{
-					Platform::log("Receiving data on %s (id %d) %dms after became pending delete. HdrId: %d dataId: %d payload: %s.",
-								  link->getEndPoint().toIpAndPort().c_str(), link->id(), timeSincePenDelete, buff[RUDPLink::off_Type], norm_id, buff);
+					for (auto& relay : relays)
+						relay.sharedPayload = RUDPLink::allocSharedPayload( relay.pack.type, relay.pack.data+1, relay.pack.len-1 );
 				}
 			}
-		
-			u32_t linkId = *(u32_t*)(buff + RUDPLink::off_Link);
-			if (!link) // add must be succesful if link wasnt found
+			if ( !link->isConnected() || link->isPendingDelete() )
+				return;
+			for (auto& relay : relays)
 			{
-				// if not known link, first packet MUST be a connect packet, otherwise discard it
-				// this is an early out routine to avoid going through the whole connection node for all 'random' packets that come in
-				if ( rawSize < RUDPLink::off_Norm_Data || 
-					 buff[RUDPLink::off_Type] != (i8_t)EHeaderPacketType::Reliable_Ordered || 
-					 buff[RUDPLink::off_Norm_Id] != (i8_t)EDataPacketType::ConnectRequest )
-				{
-					u32_t linkId = 0;
-					if ( rawSize >= 4 ) { linkId = *(u32_t*)(buff + RUDPLink::off_Link); }
-					Platform::log("WARNING: Ignoring data for link %s (id %d) as packet was not a connect request packet and connection was not know.",
-								   endPoint.toIpAndPort().c_str(), linkId );
+				const Packet& pack = relay.pack;
+				if ( link == relay.source )
 					continue;
-				}
-				link = addLink(endPoint, &linkId);
-				assert(link);
+				ESendCallResult sendResult = link->addToSendQueue( pack.data[0], pack.data+1, pack.len-1, pack.type, pack.channel, false /* relay only once */, 
+																	nullptr, nullptr, pack.subStream, relay.sharedPayload );
+				if ( sendResult == ESendCallResult::WouldBlock ) numBlocked++;
 			}
-			else if ( linkId != link->id() )
+		});
+		if ( numBlocked > 0 )
+		{
+			Platform::log("WARNING: %d relayed packets dropped, send budget of the receiving connection is full.", numBlocked);
+		}
+		for (auto& relay : relays)
+		{
+			PacketPool::release( relay.sharedPayload );
+			PacketPool::release( relay.pack.buffer );
+		}
+		relays.clear();
+	}
+
+	void RecvNode::recvDatagram(i32_t shardIdx, i8_t* buff, i32_t rawSize, const EndPoint& endPoint)
+	{
+		if ( rawSize < RUDPLink::hdr_Generic_Size )
+		{
+			Platform::log("WARNING: Incoming packet smaller than hdr size, dropping packet.");
+			return;
+		}
+
+		// get link, even if is pending delete
+		u32_t linkId = *(u32_t*)(buff + RUDPLink::off_Link);
+		bool bOwnedByOtherShard = false;
+		RUDPLink* link = getShardLink( shardIdx, linkId, endPoint, bOwnedByOtherShard );
+		if ( bOwnedByOtherShard )
+		{
+			// only happens if the kernel rehashes the peer to another socket, the owning receive thread may delete the link at any time
+			Platform::log("WARNING: Dropping packet from %s as its link is owned by another receive thread.", endPoint.toIpAndPort().c_str());
+			return;
+		}
+		if ( link && link->isPendingDelete() )
+		{
+			// Only report messages after the link has stopped lingering, otherwise we may end up with many messages that were just send after disconnect
+			// or if disconnect is re-transmitted very often due to high retransmission rate in reliable ordered protocol.
+			i8_t norm_id  = -1;
+			if ( rawSize > RUDPLink::off_Norm_Id ) norm_id = buff[RUDPLink::off_Norm_Id];
+			buff[rawSize] = '\0';
+
+			i32_t timeSincePenDelete = link->getTimeSincePendingDelete();
+			if ( timeSincePenDelete >= RUDPLink::sm_MaxLingerTimeMs )
+			{ 
+				Platform::log("WARNING: Ignoring data for link %s (id %d) as is pending delete and more than %dms lingered (%dms). HdrId: %d dataId: %d payload: %s.",
+							  link->getEndPoint().toIpAndPort().c_str(), link->id(), RUDPLink::sm_MaxLingerTimeMs, timeSincePenDelete, buff[RUDPLink::off_Type], norm_id, buff);
+				return;
+			}
+			else
 			{
-				// Fail if link id's dont match
-				i8_t hdrType  = -1;
-				i8_t dataType = -1;
-				if ( rawSize >= RUDPLink::off_Type+1 ) hdrType = buff[RUDPLink::off_Type];
-				if ( rawSize >= RUDPLink::off_Norm_Id+1 ) dataType = buff[RUDPLink::off_Norm_Id];
-				Platform::log("WARNING: Dropping packet because link id does not match. Incoming %d, having %d, hdrType %d dataType %d.",
-								linkId, link->id(), hdrType, dataType);
-				continue;
+				Platform::log("Receiving data on %s (id %d) %dms after became pending delete. HdrId: %d dataId: %d payload: %s.",
+							  link->getEndPoint().toIpAndPort().c_str(), link->id(), timeSincePenDelete, buff[RUDPLink::off_Type], norm_id, buff);
 			}
-
-			link->recvData( buff, rawSize );
 		}
+	
+		if (!link) // add must be succesful if link wasnt found
+		{
+			// if not known link, first packet MUST be a connect packet, otherwise discard it
+			// this is an early out routine to avoid going through the whole connection node for all 'random' packets that come in
+			if ( rawSize < RUDPLink::off_Norm_Data || 
+				 ((u8_t)buff[RUDPLink::off_Type] & ~RUDPLink::sm_PiggyAckBit) != (i8_t)EHeaderPacketType::Reliable_Ordered || 
+				 buff[RUDPLink::off_Norm_Id] != (i8_t)EDataPacketType::ConnectRequest )
+			{
+				u32_t linkId = 0;
+				if ( rawSize >= 4 ) { linkId = *(u32_t*)(buff + RUDPLink::off_Link); }
+				Platform::log("WARNING: Ignoring data for link %s (id %d) as packet was not a connect request packet and connection was not know.",
+							   endPoint.toIpAndPort().c_str(), linkId );
+				return;
+			}
+			link = addLink(endPoint, &linkId, shardIdx);
+			assert(link);
+		}
+		else if ( link->isCompactHeader( buff ) ? !link->isCompactLinkId( buff ) : linkId != link->id() )
+		{
+			// Fail if link id's dont match
+			i8_t hdrType  = -1;
+			i8_t dataType = -1;
+			if ( rawSize >= RUDPLink::off_Type+1 ) hdrType = buff[RUDPLink::off_Type];
+			if ( rawSize >= RUDPLink::off_Norm_Id+1 ) dataType = buff[RUDPLink::off_Norm_Id];
+			Platform::log("WARNING: Dropping packet because link id does not match. Incoming %d, having %d, hdrType %d dataType %d.",
+							linkId, link->id(), hdrType, dataType);
+			return;
+		}
+
+		link->recvData( buff, rawSize );
 	}
 
 	void RecvNode::sendThread()
 	{
-		u32_t ackAccumTime = 0;
-		u32_t relNewAccumTime = 0;
-		while ( !m_IsClosing )
+		// retransmits and acks of all links are submitted as one batch per iteration
+		BatchSocket batch( m_Socket );
+		std::vector<TimerWheel::Timer*> expired;
+		while ( true )
 		{
-			u32_t lowestLatency = ~0UL;
+			// sleep until the first timer of any link expires, scheduling an earlier one wakes it up
+			{
+				std::unique_lock<std::mutex> timerLock(m_TimerMutex);
+				if ( m_IsClosing )
+					return;
+				i32_t tNow = Util::timeNow();
+				i32_t waitTime = m_TimerWheel.getTimeUntilNext( tNow );
+				if ( waitTime < 0 || waitTime > sm_MaxSendThreadSleepMs ) waitTime = sm_MaxSendThreadSleepMs;
+				if ( waitTime > 0 )
+				{
+					m_SendThreadWakeTS = tNow + waitTime;
+					m_SendThreadSleeping = true;
+					m_SendThreadCv.wait_for( timerLock, std::chrono::milliseconds(waitTime) );
+					m_SendThreadSleeping = false;
+				}
+				if ( m_IsClosing )
+					return;
+			}
+			// links are not deleted while holding OpenLinksMutex, so the owners of expired timers stay valid
 			std::unique_lock<std::mutex> lock(m_OpenLinksMutex);
-			for (auto l : m_OpenLinksList)
 			{
-				u32_t lat = l->getLatency();
-				lowestLatency = Util::min(lat, lowestLatency);
+				std::lock_guard<std::mutex> timerLock(m_TimerMutex);
+				m_TimerWheel.advance( Util::timeNow(), expired );
 			}
-			u32_t waitTime = Util::min(lowestLatency, Util::min(m_SendRelNewestIntervalMs, m_AckAggregateTimeMs));
-			m_SendThreadCv.wait_for( lock, std::chrono::milliseconds(waitTime) );
-			if ( m_IsClosing )
-				return;
-			for (auto l : m_OpenLinksList)
+			// retransmits and new data first, so that acks are piggybacked where possible
+			for (auto timer : expired)
 			{
-				l->dispatchRelOrderedQueueIfLatencyTimePassed(waitTime, m_Socket);
+				if ( (ELinkTimer)timer->kind != ELinkTimer::Send )
+					continue;
+				RUDPLink* link = (RUDPLink*)timer->owner;
+				link->dispatchReliableOrderedQueue(&batch);
+				link->dispatchCoalescedPackets(&batch);
+				i32_t timeUntilSend = link->getTimeUntilNextSend();
+				if ( timeUntilSend >= 0 ) scheduleLink( link, ELinkTimer::Send, timeUntilSend );
 			}
-			ackAccumTime += waitTime;
-			if (ackAccumTime >= m_AckAggregateTimeMs) 
+			for (auto timer : expired)
 			{
-				ackAccumTime -= m_AckAggregateTimeMs;
-				for (auto l : m_OpenLinksList)
+				RUDPLink* link = (RUDPLink*)timer->owner;
+				switch ( (ELinkTimer)timer->kind )
 				{
-					l->dispatchAckQueue(m_Socket);
-					l->dispatchRelNewestAckQueue(m_Socket);
+				case ELinkTimer::Ack:
+					link->dispatchAcks(&batch);
+					break;
+				case ELinkTimer::ReliableNewest:
+					// resent until acked
+					if ( link->dispatchReliableNewestQueue(&batch) ) scheduleLink( link, ELinkTimer::ReliableNewest, m_SendRelNewestIntervalMs );
+					break;
+				case ELinkTimer::MtuProbe:
+				{
+					i32_t timeUntilProbe = link->dispatchMtuProbe(&batch);
+					if ( timeUntilProbe >= 0 ) scheduleLink( link, ELinkTimer::MtuProbe, timeUntilProbe );
+					break;
+				}
+				default:
+					break;
 				}
 			}
-			relNewAccumTime += waitTime;
-			if (waitTime >= m_SendRelNewestIntervalMs)
-			{
-				relNewAccumTime -= m_SendRelNewestIntervalMs;
-				for (auto l : m_OpenLinksList)
-					l->dispatchRelNewestAckQueue(m_Socket);
-			}
+			expired.clear();
+			lock.unlock();
+			batch.flush();
 		}
 	}
 
-	void RecvNode::updatePendingDeletes()
+	void RecvNode::updatePendingDeletes(i32_t shardIdx)
 	{
 		std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
 		if ( isListPinned() ) 
@@ -399,7 +719,10 @@ namespace Zerodelay
 
 			// When a link is placed in pending delete state, keep it in that for some time to ignore all remaining data that was still underway
 			// and discard it silently without throwing warnings that it it received data for a connection that is already deleted or not connected.
-			if ( link->isPinned() || !link->isPendingDelete() )
+			// Only the receive thread that owns the link deletes it, it may be using the link without lock. Links that
+			// never received anything are owned by the first.
+			i32_t owner = (link->m_RecvShard >= 0 ? link->m_RecvShard : 0);
+			if ( link->isPinned() || !link->isPendingDelete() || owner != shardIdx )
 			{
 				it++;
 				continue;
@@ -410,7 +733,9 @@ namespace Zerodelay
 			{
 				// Actually delete the connection
 				Platform::log("Link to %s id: %d deleted.", link->getEndPoint().toIpAndPort().c_str(), link->id());
-				m_OpenLinksMap.erase(link->getEndPoint());
+				cancelLinkTimers(link);
+				m_OpenLinksMap.remove(link);
+				m_Shards[shardIdx].links.remove(link);
 				delete link;
 				it = m_OpenLinksList.erase(it);
 			}
@@ -424,31 +749,66 @@ namespace Zerodelay
 	RUDPLink* RecvNode::getLink(const EndPoint& endPoint, bool getIfIsPendingDelete) const
 	{
 		std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
-		auto it = m_OpenLinksMap.find( endPoint );
-		if ( it != m_OpenLinksMap.end() && (getIfIsPendingDelete || !it->second->isPendingDelete()) )
+		RUDPLink* link = m_OpenLinksMap.find( endPoint );
+		if ( link && (getIfIsPendingDelete || !link->isPendingDelete()) )
 		{
-			return it->second;
+			return link;
 		}
 		return nullptr;
 	}
 
-	class RUDPLink* RecvNode::addLink(const EndPoint& endPoint, const u32_t* linkIdPtr)
+	RUDPLink* RecvNode::getShardLink(i32_t shardIdx, u32_t linkId, const EndPoint& endPoint, bool& ownedByOtherShard)
+	{
+		ownedByOtherShard = false;
+		LinkTable& links = m_Shards[shardIdx].links;
+		RUDPLink* link = links.find( linkId, endPoint );
+		if ( !link ) link = links.find( endPoint ); // link id mismatch, caller reports it
+		if ( link )
+		{
+			return link;
+		}
+		// first datagram of a link that was added by connect, or an unknown endpoint
+		std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
+		link = m_OpenLinksMap.find( endPoint );
+		if ( !link )
+		{
+			return nullptr;
+		}
+		if ( link->m_RecvShard == -1 )
+		{
+			link->m_RecvShard = shardIdx;
+		}
+		if ( link->m_RecvShard != shardIdx )
+		{
+			ownedByOtherShard = true;
+			return nullptr;
+		}
+		links.add( link );
+		return link;
+	}
+
+	class RUDPLink* RecvNode::addLink(const EndPoint& endPoint, const u32_t* linkIdPtr, i32_t recvShard)
 	{
 		std::lock_guard<std::mutex> lock(m_OpenLinksMutex);
-		auto it = m_OpenLinksMap.find( endPoint );
-		if ( it == m_OpenLinksMap.end() )
+		if ( !m_OpenLinksMap.find( endPoint ) )
 		{
 			u32_t linkId;
 			if ( linkIdPtr ) linkId = *linkIdPtr;
 			else 
 			{ 
-				linkId = rand();
+				linkId = rand() & ~(u32_t)RUDPLink::sm_CompactHdrBit; // so that the link can use compact headers
 				Platform::log("New LinkId %d generated.", linkId);
 			}
 			Platform::log("Link to %s (id %d) added.", endPoint.toIpAndPort().c_str(), linkId);
 			RUDPLink* link = new RUDPLink( this, endPoint, linkId );
-			m_OpenLinksMap[endPoint] = link;
+			link->m_RecvShard = recvShard;
+			if ( recvShard >= 0 )
+			{
+				m_Shards[recvShard].links.add( link );
+			}
+			m_OpenLinksMap.add( link );
 			m_OpenLinksList.emplace_back( link );
+			scheduleLink( link, ELinkTimer::MtuProbe, 0 ); // waits for the link to be connected
 			return link;
 		}
 		return nullptr;
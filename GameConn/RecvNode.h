@@ -2,7 +2,10 @@
 
 #include "EndPoint.h"
 #include "CoreNode.h"
+#include "LinkTable.h"
+#include "TimerWheel.h"
 
+#include <atomic>
 #include <cstring>
 #include <mutex>
 #include <map>
@@ -22,15 +25,54 @@ namespace Zerodelay
 		u32_t linkId;
 		i32_t len; 
 		i8_t* data;
+		const i8_t* buffer; // PacketPool buffer that data points into (may be a slice of a received datagram), released when done
 		i8_t channel;
 		u8_t flags; // Relay | firstFragmant | lastFragment
 		EHeaderPacketType type;
+		u32_t subStream; // Reliable_SubStream only
+		// send only, payload that is shared with the packets of other links and follows data on the wire (len includes it)
+		const i8_t* payload;
+		const i8_t* payloadBuffer; // PacketPool buffer that payload points into, nullptr if none
+		i32_t payloadLen;
+	};
+
+
+	// Per link timers on the timer wheel of the send thread.
+	enum class ELinkTimer : i32_t
+	{
+		Send,			// retransmissions, paced new data and coalesce deadline
+		Ack,			// pending acks, sent after the ack aggregate time
+		ReliableNewest,	// unacked reliable newest data, resent every reliable newest interval
+		MtuProbe,
+		Count
+	};
+
+
+	// With SO_REUSEPORT several sockets share a port and the kernel spreads peers over them by flow hash.
+	// Each shard has its own socket and receive thread, and owns the links whose data arrives on it.
+	// A received user packet that is sent on to the other links by the receive thread, instead of waiting for the game thread.
+	struct RelayItem
+	{
+		Packet pack;				// holds a reference to its buffer
+		class RUDPLink* source;		// not relayed back to this one
+		const i8_t* sharedPayload;	// built once if relayed to more than one link
+	};
+
+
+	struct RecvShard
+	{
+		class ISocket* socket;
+		std::thread* thread;
+		LinkTable links; // only touched by its own receive thread, so no lock
+		std::vector<RelayItem> relays; // received in the current batch, only touched by its own receive thread
 	};
 
 
 	class RecvNode
 	{
 	public:
+		static const i32_t sm_MaxSendThreadSleepMs = 1000;
+
 		RecvNode(u32_t sendRelNewestIntervalMs=33, u32_t ackAggregateTimeMs=8);
 		virtual ~RecvNode();
 		void reset();
@@ -40,12 +82,13 @@ namespace Zerodelay
 
 		ESendCallResult send( u8_t id, const i8_t* data, i32_t len, const EndPoint* specific=nullptr, bool exclude=false, 
 							  EHeaderPacketType type=EHeaderPacketType::Reliable_Ordered, u8_t channel=0, bool relay=true, 
-							  std::vector<ZAckTicket>* deliveryTraceOut=nullptr );
+							  std::vector<ZAckTicket>* deliveryTraceOut=nullptr, u32_t subStream=0 );
 		void sendReliableNewest( u8_t id, u32_t groupId, i8_t groupBit, const i8_t* data, i32_t len, const EndPoint* specific=nullptr, bool exclude=false );
 
 		class RUDPLink* getLinkAndPinIt(u32_t idx) const;
 		class RUDPLink* getLinkAndPinIt( const EndPoint& endpoint ) const;
 		void unpinLink(RUDPLink* link) const;
+		bool queueRelay( i32_t shardIdx, const Packet& pack, class RUDPLink* source ); // call from receive, false if not relayed by receive thread
 
 		// This functionality can only be called from one thread (the main usually)
 		void pinList(); // call from main
@@ -53,36 +96,77 @@ namespace Zerodelay
 		void unpinList(); // call from main
 
 		void simulatePacketLoss( i32_t percentage );
+		void setReliableWindow( u32_t numFragments );	// applies to links created afterwards
+		u32_t getReliableWindow() const { return m_ReliableWindow; }
+		void setCongestionControl( ECongestionControl type ) { m_CongestionControl = type; } // applies to links created afterwards
+		ECongestionControl getCongestionControl() const { return m_CongestionControl; }
+		void setCoalesceDelay( u32_t delayMs ) { m_CoalesceDelayMs = delayMs; } // 0 disables coalescing
+		void setNumRecvThreads( u32_t numThreads ) { m_NumRecvThreads = (numThreads > 0 ? numThreads : 1); } // applies to sockets opened afterwards
+		u32_t getCoalesceDelay() const { return m_CoalesceDelayMs; }
+		void setLowLatency( bool enabled ) { m_LowLatency = enabled; }
+		bool isLowLatency() const { return m_LowLatency; }
+		void setFecGroupSize( u8_t channel, u32_t groupSize ); // applies to links created afterwards
+		u32_t getFecGroupSize( u8_t channel ) const { return m_FecGroupSize[channel]; }
+		void setRedundancy( u8_t channel, u32_t numPrevious ); // applies to links created afterwards
+		u32_t getRedundancy( u8_t channel ) const { return m_Redundancy[channel]; }
+		void setSendBudget( i32_t channel, u32_t maxBytes, u32_t maxMessages ); // channel -1 is the whole link, 0 is unlimited, applies to links created afterwards
+		u32_t getSendBudgetBytes( i32_t channel ) const { return m_SendBudgetBytes[channel+1]; }
+		u32_t getSendBudgetMessages( i32_t channel ) const { return m_SendBudgetMessages[channel+1]; }
+		void flush(); // call from main
+		void wakeSendThread();
+		void scheduleLink( class RUDPLink* link, ELinkTimer timer, i32_t delayMs ); // any thread, an earlier deadline of the timer is kept
+		u32_t getAckAggregateTime() const { return m_AckAggregateTimeMs; }
+		u32_t getReliableNewestInterval() const { return m_SendRelNewestIntervalMs; }
 		class ISocket* getSocket() const { return m_Socket; }
 
 		class RUDPLink* getLink( const EndPoint& endPoint, bool getIfIsPendingDelete ) const; // only safe to use by recv thread as recv thread is responsible for deleting the links
-		class RUDPLink* addLink( const EndPoint& endPoint, const u32_t* linkPtr ); // returns nullptr if already exists
+		class RUDPLink* addLink( const EndPoint& endPoint, const u32_t* linkPtr, i32_t recvShard=-1 ); // returns nullptr if already exists
 		void startThreads();
 
 		i32_t getNumOpenLinks() const;
 		bool isPacketDelivered(const ZEndpoint& ztp, u32_t sequences, u32_t numFragments, i8_t channel) const;
+		bool getLatency(const ZEndpoint& ztp, u32_t& latencyOut, u32_t& varianceOut) const;
+		bool getQueuedSend(const ZEndpoint& ztp, i32_t channel, u32_t& bytesOut, u32_t& messagesOut) const;
 		CoreNode* getCoreNode() const { return m_CoreNode; }
 
 	private:
-		void recvThread();
+		void recvThread( i32_t shardIdx );
+		void recvDatagram( i32_t shardIdx, i8_t* buff, i32_t rawSize, const EndPoint& endPoint );
+		class RUDPLink* getShardLink( i32_t shardIdx, u32_t linkId, const EndPoint& endPoint, bool& ownedByOtherShard ); // only from the shard's receive thread
 		void sendThread();
-		void updatePendingDeletes();
+		void updatePendingDeletes( i32_t shardIdx );
+		void relayPackets( i32_t shardIdx );
+		void cancelLinkTimers( class RUDPLink* link ); // before it is deleted
 
 		// for each link (only to b called from main thread)
 		template <typename Callback>
 		void forEachLink( const EndPoint* specific, bool exclude, bool connected, u32_t& linkCount, const Callback& cb );
 
 		volatile bool m_IsClosing;
-		class ISocket* m_Socket;
+		class ISocket* m_Socket;	// first shard's socket, all sends go through this one
 		bool  m_CaptureSocketErrors;
 		u32_t m_SendRelNewestIntervalMs;
 		u32_t m_AckAggregateTimeMs;
-		std::thread* m_RecvThread;
+		u32_t m_ReliableWindow;
+		std::atomic<u32_t> m_CoalesceDelayMs;
+		std::atomic<bool> m_LowLatency;	// no aggregate delays, the send thread is woken by new acks and data
+		ECongestionControl m_CongestionControl;
+		u32_t m_NumRecvThreads;
+		u32_t m_FecGroupSize[8];	// per channel (RUDPLink::sm_NumChannels), 0 is off
+		u32_t m_Redundancy[8];		// per channel, num previous unreliable redundant messages repeated
+		u32_t m_SendBudgetBytes[9];	// [0] is per link, then per channel, 0 is unlimited
+		u32_t m_SendBudgetMessages[9];
+		std::vector<RecvShard> m_Shards;	// not resized while receive threads run
 		std::thread* m_SendThread;
-		std::condition_variable m_SendThreadCv;
+		// timers of all links, the send thread only touches links whose timer expired
+		std::mutex m_TimerMutex;	// never held while taking another lock
+		TimerWheel m_TimerWheel;
+		std::condition_variable m_SendThreadCv;	// waits with TimerMutex
+		bool  m_SendThreadSleeping;
+		i32_t m_SendThreadWakeTS;	// when sleeping, a timer that is due earlier wakes it up
 		mutable std::mutex m_OpenLinksMutex;
 		// Currently opened links are put in a list so that reopend links on same address can not depend on a previously opened session
-		std::map<EndPoint, class RUDPLink*, EndPoint::STLCompare> m_OpenLinksMap;
+		LinkTable m_OpenLinksMap;
 		std::vector<class RUDPLink*> m_OpenLinksList;
 		volatile u32_t m_ListPinned;
 		// -- Ptrs to other managers
@@ -90,40 +174,4 @@ namespace Zerodelay
 		class ConnectionNode* m_ConnectionNode;
 	};
 
-
-	template <typename Callback>
-	void RecvNode::forEachLink(const EndPoint* specific, bool exclude, bool connected, u32_t& linkCount, const Callback& cb)
-	{
-		pinList();
-		linkCount = (u32_t) m_OpenLinksList.size();
-		if ( specific )
-		{
-			if ( exclude )
-			{
-				for ( auto it : m_OpenLinksList )
-				{
-					if ( it->getEndPoint() != *specific )
-					{
-						cb( it );
-					}
-				}
-			}
-			else
-			{
-				auto it = m_OpenLinksMap.find( *specific );
-				if ( it != m_OpenLinksMap.end() )
-				{
-					cb( it->second );
-				}
-			}
-		}
-		else
-		{
-			for ( auto it : m_OpenLinksList ) 
-			{
-				cb( it );
-			}
-		}
-		unpinList();
-	}
 }
\ No newline at end of file
@@ -1,8 +1,15 @@
 #include "Socket.h"
 #include "Platform.h"
+#include "Util.h"
 
 #include <cassert>
 
+#if ZERODELAY_POSIXSOCKET
+	#include <cerrno>
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+#endif
+
 
 namespace Zerodelay
 {
@@ -22,10 +29,105 @@ namespace Zerodelay
 	#endif
 	#if ZERODELAY_SDLSOCKET
 		return new SDLSocket();
+	#endif
+	#if ZERODELAY_POSIXSOCKET
+		return new PosixSocket();
 	#endif
 		return nullptr;
 	}
 
+	ESendResult ISocket::sendBatch(const Datagram* datagrams, i32_t num)
+	{
+		ESendResult result = ESendResult::Succes;
+		for (i32_t i=0; i<num; ++i)
+		{
+			ESendResult res = send( datagrams[i].endPoint, datagrams[i].data, datagrams[i].len );
+			if ( res == ESendResult::SocketClosed )
+				return res;
+			if ( res != ESendResult::Succes )
+				result = res;
+		}
+		return result;
+	}
+
+	ESendResult ISocket::sendGather(const EndPoint& endPoint, const i8_t* hdr, i32_t hdrLen, const i8_t* data, i32_t len)
+	{
+		i8_t buff[ZERODELAY_BUFF_RECV_SIZE];
+		if ( hdrLen + len > (i32_t)sizeof(buff) )
+			return ESendResult::Error;
+		Platform::memCpy( buff, sizeof(buff), hdr, hdrLen );
+		Platform::memCpy( buff + hdrLen, sizeof(buff) - hdrLen, data, len );
+		return send( endPoint, buff, hdrLen + len );
+	}
+
+	ERecvResult ISocket::recvBatch(Datagram* datagrams, i32_t& num)
+	{
+		if ( num <= 0 )
+			return ERecvResult::NoData;
+		// a second recv may block on a blocking socket, so only receive one
+		ERecvResult result = recv( datagrams[0].data, datagrams[0].len, datagrams[0].endPoint );
+		num = (result == ERecvResult::Succes ? 1 : 0);
+		return result;
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////
+	// Batch Socket
+	//////////////////////////////////////////////////////////////////////////
+
+	BatchSocket::BatchSocket(ISocket* socket):
+		m_Socket(socket),
+		m_Buffer(sm_MaxBatchSize * ZERODELAY_BUFF_RECV_SIZE),
+		m_NumDatagrams(0)
+	{
+		m_Open  = true;
+		m_Bound = true;
+		m_Blocking = socket->isBlocking();
+		m_IpProto  = socket->getIpProtocol();
+		for (i32_t i=0; i<sm_MaxBatchSize; ++i)
+		{
+			m_Datagrams[i].data = m_Buffer.data() + i*ZERODELAY_BUFF_RECV_SIZE;
+		}
+	}
+
+	BatchSocket::~BatchSocket()
+	{
+		flush();
+	}
+
+	ESendResult BatchSocket::send(const EndPoint& endPoint, const i8_t* data, i32_t len)
+	{
+		return sendGather( endPoint, data, len, nullptr, 0 );
+	}
+
+	ESendResult BatchSocket::sendGather(const EndPoint& endPoint, const i8_t* hdr, i32_t hdrLen, const i8_t* data, i32_t len)
+	{
+		if ( hdrLen + len > ZERODELAY_BUFF_RECV_SIZE )
+		{
+			flush(); // keep order
+			return len > 0 ? m_Socket->sendGather( endPoint, hdr, hdrLen, data, len ) : m_Socket->send( endPoint, hdr, hdrLen );
+		}
+		if ( m_NumDatagrams == sm_MaxBatchSize )
+		{
+			flush();
+		}
+		Datagram& dg = m_Datagrams[m_NumDatagrams++];
+		Platform::memCpy( dg.data, ZERODELAY_BUFF_RECV_SIZE, hdr, hdrLen );
+		if ( len > 0 ) Platform::memCpy( dg.data + hdrLen, ZERODELAY_BUFF_RECV_SIZE - hdrLen, data, len );
+		dg.len = hdrLen + len;
+		dg.endPoint = endPoint;
+		return ESendResult::Succes;
+	}
+
+	void BatchSocket::flush()
+	{
+		if ( m_NumDatagrams == 0 )
+			return;
+		ESendResult result = m_Socket->sendBatch( m_Datagrams, m_NumDatagrams );
+		m_LastError = result == ESendResult::Error ? (SocketError)m_Socket->getUnderlayingSocketError() : SocketError::Succes;
+		m_NumDatagrams = 0;
+	}
+
 #if ZERODELAY_FAKESOCKET
 
 	//////////////////////////////////////////////////////////////////////////
@@ -96,7 +198,7 @@ namespace Zerodelay
 		m_Blocking = true;
 	}
 
-	bool BSDSocket::open(IPProto ipv, bool reuseAddr)
+	bool BSDSocket::open(IPProto ipv, bool reuseAddr, bool reusePort)
 	{
 		if ( m_Open && m_Socket != INVALID_SOCKET )
 		{
@@ -120,6 +222,7 @@ namespace Zerodelay
 			setLastError();
 			return false;
 		}
+		// reusePort is not supported on Windows, binding a second socket to the same port fails instead
 
 		m_Open = true;
 		return true;
@@ -269,7 +372,7 @@ namespace Zerodelay
 		SDLNet_FreeSocketSet(m_SocketSet);
 	}
 
-	bool SDLSocket::open(IPProto ipProto, bool reuseAddr)
+	bool SDLSocket::open(IPProto ipProto, bool reuseAddr, bool reusePort)
 	{
 		if (m_LastError!=SocketError::Succes) return false;
 		m_Open = true;
@@ -405,4 +508,385 @@ namespace Zerodelay
 	}
 
 #endif
+
+
+#if ZERODELAY_POSIXSOCKET
+
+	//////////////////////////////////////////////////////////////////////////
+	// Posix Socket
+	//////////////////////////////////////////////////////////////////////////
+
+	PosixSocket::PosixSocket():
+		m_Socket(-1),
+		m_EpollFd(-1),
+		m_WakeupFd(-1)
+	{
+		m_Blocking = true; // recv waits for data with a timeout
+		m_EpollFd  = epoll_create1(EPOLL_CLOEXEC);
+		m_WakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if ( m_EpollFd == -1 || m_WakeupFd == -1 )
+		{
+			m_LastError = SocketError::CannotCreateSet;
+			return;
+		}
+		epoll_event ev = {};
+		ev.events  = EPOLLIN;
+		ev.data.fd = m_WakeupFd;
+		if ( 0 != epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, m_WakeupFd, &ev) )
+		{
+			m_LastError = SocketError::CannotAddToSet;
+		}
+	}
+
+	PosixSocket::~PosixSocket()
+	{
+		close();
+		releaseSocket();
+		if ( m_EpollFd != -1 )  ::close( m_EpollFd );
+		if ( m_WakeupFd != -1 ) ::close( m_WakeupFd );
+	}
+
+	bool PosixSocket::open(IPProto /*ipProto*/, bool reuseAddr, bool reusePort)
+	{
+		if ( m_EpollFd == -1 || m_WakeupFd == -1 )
+			return false;
+		m_LastError = SocketError::Succes;
+
+		if ( m_Open && m_Socket != -1 )
+		{
+			return true;
+		}
+		// reset open state if was invalid socket, receive threads of a previous open are joined by now
+		m_Open = false;
+		releaseSocket();
+
+		// consume wakeup of a previous close
+		eventfd_t wakeups;
+		eventfd_read( m_WakeupFd, &wakeups );
+
+		// prefer dual stack regardless of ipProto, Ipv4 peers then appear as Ipv4 mapped Ipv6 addresses
+		m_Socket = ::socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+		if ( m_Socket != -1 )
+		{
+			i32_t v6Only = 0;
+			if ( 0 != setsockopt(m_Socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only)) )
+			{
+				::close( m_Socket );
+				m_Socket = -1;
+			}
+		}
+		m_IpProto = IPProto::Ipv6;
+		if ( m_Socket == -1 )
+		{
+			m_Socket  = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+			m_IpProto = IPProto::Ipv4;
+		}
+		if ( m_Socket == -1 )
+		{
+			setLastError();
+			return false;
+		}
+
+		i32_t bReuseAddr = reuseAddr ? 1 : 0;
+		if ( 0 != setsockopt(m_Socket, SOL_SOCKET, SO_REUSEADDR, &bReuseAddr, sizeof(bReuseAddr)) )
+		{
+			setLastError();
+			return false;
+		}
+
+		// kernel spreads incoming datagrams over all sockets on the port by hash of the source address
+		i32_t bReusePort = reusePort ? 1 : 0;
+		if ( 0 != setsockopt(m_Socket, SOL_SOCKET, SO_REUSEPORT, &bReusePort, sizeof(bReusePort)) )
+		{
+			setLastError();
+			return false;
+		}
+
+		// default buffers (~200KB) overflow when a full reliable window arrives at once, kernel caps this at rmem_max/wmem_max
+		i32_t bufferSize = sm_SocketBufferSize;
+		setsockopt(m_Socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+		setsockopt(m_Socket, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+		// set don't fragment without applying the cached path mtu, links probe the datagram size themselves
+		i32_t pmtuDisc = IP_PMTUDISC_PROBE;
+		setsockopt(m_Socket, IPPROTO_IP, IP_MTU_DISCOVER, &pmtuDisc, sizeof(pmtuDisc));
+		if ( m_IpProto == IPProto::Ipv6 )
+		{
+			pmtuDisc = IPV6_PMTUDISC_PROBE;
+			setsockopt(m_Socket, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &pmtuDisc, sizeof(pmtuDisc));
+		}
+
+		epoll_event ev = {};
+		ev.events  = EPOLLIN;
+		ev.data.fd = m_Socket;
+		if ( 0 != epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, m_Socket, &ev) )
+		{
+			m_LastError = SocketError::CannotAddToSet;
+			return false;
+		}
+
+		m_Open = true;
+		return true;
+	}
+
+	bool PosixSocket::bind(u16_t port)
+	{
+		if ( m_Socket == -1 )
+		{
+			m_LastError = SocketError::NotOpened;
+			return false;
+		}
+		m_LastError = SocketError::Succes;
+
+		if ( m_Bound )
+			return true;
+
+		i32_t res;
+		if ( m_IpProto == IPProto::Ipv6 )
+		{
+			sockaddr_in6 addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin6_family = AF_INET6;
+			addr.sin6_port   = Util::htons(port);
+			addr.sin6_addr   = in6addr_any;
+			res = ::bind(m_Socket, (const sockaddr*)&addr, sizeof(addr));
+		}
+		else
+		{
+			sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port   = Util::htons(port);
+			addr.sin_addr.s_addr = INADDR_ANY;
+			res = ::bind(m_Socket, (const sockaddr*)&addr, sizeof(addr));
+		}
+
+		if ( res != 0 )
+		{
+			if ( errno == EADDRINUSE )
+				m_LastError = SocketError::PortAlreadyInUse;
+			else
+				setLastError();
+			return false;
+		}
+
+		m_Bound = true;
+		return true;
+	}
+
+	bool PosixSocket::close()
+	{
+		m_Bound = false;
+		if ( !m_Open.exchange( false ) )
+		{
+			// was already closed or never opened
+			return false;
+		}
+		// wake up recv threads, they see the socket is no longer open and return
+		if ( m_WakeupFd != -1 ) 
+		{
+			eventfd_write( m_WakeupFd, 1 );
+		}
+		return true;
+	}
+
+	void PosixSocket::releaseSocket()
+	{
+		if ( m_Socket == -1 )
+			return;
+		epoll_ctl( m_EpollFd, EPOLL_CTL_DEL, m_Socket, nullptr );
+		if ( 0 != ::close( m_Socket ) )
+		{
+			setLastError();
+		}
+		m_Socket = -1;
+	}
+
+	void PosixSocket::setLastError()
+	{
+		m_LastError = (SocketError)errno;
+	}
+
+	const sockaddr* PosixSocket::getSendAddr(const EndPoint& endPoint, sockaddr_in6& mapped, socklen_t& addrSize) const
+	{
+		const sockaddr* addr = (const sockaddr*)endPoint.getLowLevelAddr();
+		addrSize = (socklen_t)endPoint.getLowLevelAddrSize();
+
+		// Ipv4 destination on dual stack socket must be addressed as Ipv4 mapped Ipv6
+		if ( m_IpProto == IPProto::Ipv6 && addr->sa_family == AF_INET )
+		{
+			const sockaddr_in* v4 = (const sockaddr_in*)addr;
+			memset(&mapped, 0, sizeof(mapped));
+			mapped.sin6_family = AF_INET6;
+			mapped.sin6_port   = v4->sin_port;
+			mapped.sin6_addr.s6_addr[10] = 0xFF;
+			mapped.sin6_addr.s6_addr[11] = 0xFF;
+			memcpy( mapped.sin6_addr.s6_addr + 12, &v4->sin_addr.s_addr, 4 );
+			addr = (const sockaddr*)&mapped;
+			addrSize = sizeof(mapped);
+		}
+		return addr;
+	}
+
+	ESendResult PosixSocket::send(const EndPoint& endPoint, const i8_t* data, i32_t len)
+	{
+		if ( m_Socket == -1 || !m_Open )
+			return ESendResult::SocketClosed;
+
+		sockaddr_in6 mapped;
+		socklen_t addrSize;
+		const sockaddr* addr = getSendAddr( endPoint, mapped, addrSize );
+
+		if ( -1 == sendto( m_Socket, data, len, 0, addr, addrSize ) )
+		{
+			// socket send buffer full (EAGAIN) is treated as loss, reliable data is retransmitted
+			setLastError();
+			return ESendResult::Error;
+		}
+
+		return ESendResult::Succes;
+	}
+
+	ESendResult PosixSocket::sendGather(const EndPoint& endPoint, const i8_t* hdr, i32_t hdrLen, const i8_t* data, i32_t len)
+	{
+		if ( m_Socket == -1 || !m_Open )
+			return ESendResult::SocketClosed;
+
+		sockaddr_in6 mapped;
+		socklen_t addrSize;
+		iovec iovs[2];
+		iovs[0].iov_base = (void*)hdr;
+		iovs[0].iov_len  = hdrLen;
+		iovs[1].iov_base = (void*)data;
+		iovs[1].iov_len  = len;
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name    = (void*)getSendAddr( endPoint, mapped, addrSize );
+		msg.msg_namelen = addrSize;
+		msg.msg_iov     = iovs;
+		msg.msg_iovlen  = 2;
+
+		if ( -1 == sendmsg( m_Socket, &msg, 0 ) )
+		{
+			// as with send, a failure is treated as loss
+			setLastError();
+			return ESendResult::Error;
+		}
+
+		return ESendResult::Succes;
+	}
+
+	ERecvResult PosixSocket::recv(i8_t* buff, i32_t& rawSize, EndPoint& endPoint)
+	{
+		Datagram dg;
+		dg.data = buff;
+		dg.len  = rawSize;
+		i32_t num = 1;
+		ERecvResult result = recvBatch( &dg, num );
+		if ( result == ERecvResult::Succes )
+		{
+			rawSize  = dg.len;
+			endPoint = dg.endPoint;
+		}
+		return result;
+	}
+
+	ESendResult PosixSocket::sendBatch(const Datagram* datagrams, i32_t num)
+	{
+		if ( m_Socket == -1 || !m_Open )
+			return ESendResult::SocketClosed;
+
+		ESendResult result = ESendResult::Succes;
+		mmsghdr msgs[sm_MaxBatchSize];
+		iovec iovs[sm_MaxBatchSize];
+		sockaddr_in6 mapped[sm_MaxBatchSize];
+		while ( num > 0 )
+		{
+			i32_t kBatch = Util::min( num, sm_MaxBatchSize );
+			memset(msgs, 0, sizeof(mmsghdr)*kBatch);
+			for (i32_t i=0; i<kBatch; ++i)
+			{
+				socklen_t addrSize;
+				iovs[i].iov_base = datagrams[i].data;
+				iovs[i].iov_len  = datagrams[i].len;
+				msgs[i].msg_hdr.msg_name    = (void*)getSendAddr( datagrams[i].endPoint, mapped[i], addrSize );
+				msgs[i].msg_hdr.msg_namelen = addrSize;
+				msgs[i].msg_hdr.msg_iov     = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen  = 1;
+			}
+			i32_t kSent = sendmmsg( m_Socket, msgs, kBatch, 0 );
+			if ( kSent <= 0 )
+			{
+				// as with send, a failure is treated as loss
+				setLastError();
+				result = ESendResult::Error;
+				if ( errno == EAGAIN || errno == EWOULDBLOCK )
+					return result; // socket send buffer full, remainder would fail too
+				kSent = 1; // skip the datagram that failed (eg. unreachable destination)
+			}
+			datagrams += kSent;
+			num -= kSent;
+		}
+		return result;
+	}
+
+	ERecvResult PosixSocket::recvBatch(Datagram* datagrams, i32_t& num)
+	{
+		i32_t kMax = Util::min( num, sm_MaxBatchSize );
+		num = 0;
+		mmsghdr msgs[sm_MaxBatchSize];
+		iovec iovs[sm_MaxBatchSize];
+		sockaddr_in6 addrs[sm_MaxBatchSize];
+		bool bWaited = false;
+		// receive thread reads the error after a call that returned no data, so only report an error of this call
+		m_LastError = SocketError::Succes;
+		while ( true )
+		{
+			if ( m_Socket == -1 || !m_Open )
+				return ERecvResult::SocketClosed;
+
+			memset(msgs, 0, sizeof(mmsghdr)*kMax);
+			for (i32_t i=0; i<kMax; ++i)
+			{
+				iovs[i].iov_base = datagrams[i].data;
+				iovs[i].iov_len  = datagrams[i].len;
+				msgs[i].msg_hdr.msg_name    = &addrs[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+				msgs[i].msg_hdr.msg_iov     = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen  = 1;
+			}
+			// drains what is queued in the socket up to kMax datagrams, does not wait for more
+			i32_t res = recvmmsg( m_Socket, msgs, kMax, 0, nullptr );
+			if ( res > 0 )
+			{
+				for (i32_t i=0; i<res; ++i)
+				{
+					datagrams[i].len = (i32_t)msgs[i].msg_len;
+					datagrams[i].endPoint.setFromLowLevelAddr( &addrs[i], (i32_t)msgs[i].msg_hdr.msg_namelen );
+				}
+				num = res;
+				return ERecvResult::Succes;
+			}
+
+			if ( res == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+			{
+				if ( !m_Open ) // if closing, ignore error
+					return ERecvResult::SocketClosed;
+				setLastError();
+				return ERecvResult::Error;
+			}
+
+			if ( bWaited )
+				return ERecvResult::NoData;
+
+			// nothing available, wait for data or close
+			epoll_event events[2];
+			i32_t numEvents = epoll_wait( m_EpollFd, events, 2, sm_RecvWaitTimeoutMs );
+			if ( numEvents <= 0 )
+				return ERecvResult::NoData;
+			bWaited = true;
+		}
+	}
+
+#endif
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <mutex>
 #include <deque>
 #include <atomic>
+#include <vector>
 
 
 namespace Zerodelay
@@ -48,22 +49,41 @@ namespace Zerodelay
 	};
 
 
+	// Single datagram in a batch send or receive.
+	struct Datagram
+	{
+		i8_t* data;
+		i32_t len;			// recv: buffer size in, received size out
+		EndPoint endPoint;
+	};
+
+
 	class ISocket
 	{
 	protected:
 		ISocket();
 
 	public:
+		static const i32_t sm_MaxBatchSize = 64;
+
 		static ISocket* create();
 		virtual ~ISocket() = default;
 
 		// Interface
-		virtual bool open(IPProto ipProto = IPProto::Ipv4, bool reuseAddr=false) = 0;
+		virtual bool open(IPProto ipProto = IPProto::Ipv4, bool reuseAddr=false, bool reusePort=false) = 0; // reusePort: several sockets may bind the same port (SO_REUSEPORT)
 		virtual bool bind(u16_t port) = 0;
 		virtual bool close() = 0;
 		virtual ESendResult send( const struct EndPoint& endPoint, const i8_t* data, i32_t len ) = 0;
 		virtual ERecvResult recv( i8_t* buff, i32_t& rawSize, struct EndPoint& endpointOut ) = 0; // buffSize in, received size out
 
+		// Sends hdr followed by data as a single datagram, default copies them together and does a send.
+		virtual ESendResult sendGather( const struct EndPoint& endPoint, const i8_t* hdr, i32_t hdrLen, const i8_t* data, i32_t len );
+
+		// Batch versions, default does a send per datagram and receives a single datagram. 
+		// For recvBatch, num is the number of datagrams in, number received out.
+		virtual ESendResult sendBatch( const Datagram* datagrams, i32_t num );
+		virtual ERecvResult recvBatch( Datagram* datagrams, i32_t& num );
+
 		// Shared
 		bool isOpen() const  { return m_Open; }
 		bool isBound() const { return m_Bound; }
@@ -72,13 +92,38 @@ namespace Zerodelay
 		i32_t getUnderlayingSocketError() const { return (i32_t) m_LastError; }
 
 	protected:
-		bool m_Open;
+		std::atomic<bool> m_Open; // cleared by close while receive threads may be waiting
 		bool m_Bound;
 		bool m_Blocking;
 		IPProto m_IpProto;
 		SocketError m_LastError;
 	};
 
+	// Collects the datagrams sent by a single thread and submits them with one sendBatch call when full or flushed.
+	// Data is copied, so the caller may release it after send returns.
+	class BatchSocket: public ISocket
+	{
+	public:
+		BatchSocket(ISocket* socket);
+		~BatchSocket() override;
+
+		// ISocket
+		virtual bool open(IPProto ipProto, bool reuseAddr, bool reusePort) override { return m_Socket->open(ipProto, reuseAddr, reusePort); }
+		virtual bool bind(u16_t port) override { return m_Socket->bind(port); }
+		virtual bool close() override { return m_Socket->close(); }
+		virtual ESendResult send( const struct EndPoint& endPoint, const i8_t* data, i32_t len) override;
+		virtual ERecvResult recv( i8_t* buff, i32_t& rawSize, struct EndPoint& endPoint ) override { return m_Socket->recv(buff, rawSize, endPoint); }
+		virtual ESendResult sendGather( const struct EndPoint& endPoint, const i8_t* hdr, i32_t hdrLen, const i8_t* data, i32_t len ) override;
+
+		void flush();
+
+	private:
+		ISocket* m_Socket;
+		std::vector<i8_t> m_Buffer;
+		Datagram m_Datagrams[sm_MaxBatchSize];
+		i32_t m_NumDatagrams;
+	};
+
 #if ZERODELAY_FAKESOCKET
 	class FakeSocket: public ISocket
 	{
@@ -92,7 +137,7 @@ namespace Zerodelay
 	public:
 		virtual ~FakeSocket();
 
-		virtual bool open(IPProto ipProto, bool reuseAddr) override { return true; }
+		virtual bool open(IPProto ipProto, bool reuseAddr, bool reusePort) override { return true; }
 		virtual bool bind(u16_t port) override { return true; }
 		virtual bool close() override { return true; }
 		virtual ESendResult send( const struct EndPoint& endPoint, const i8_t* data, i32_t len) override;
@@ -115,7 +160,7 @@ namespace Zerodelay
 	public:
 		BSDSocket();
 
-		virtual bool open(IPProto ipProto, bool reuseAddr) override;
+		virtual bool open(IPProto ipProto, bool reuseAddr, bool reusePort) override;
 		virtual bool bind(u16_t port) override;
 		virtual bool close() override;
 		virtual ESendResult send( const struct EndPoint& endPoint, const i8_t* data, i32_t len) override;
@@ -136,7 +181,7 @@ namespace Zerodelay
 		~SDLSocket() override;
 
 		// ISocket
-		virtual bool open(IPProto ipProto, bool reuseAddr) override;
+		virtual bool open(IPProto ipProto, bool reuseAddr, bool reusePort) override;
 		virtual bool bind(u16_t port) override;
 		virtual bool close() override;
 		virtual ESendResult send( const struct EndPoint& endPoint, const i8_t* data, i32_t len) override;
@@ -147,4 +192,37 @@ namespace Zerodelay
 		SDLNet_SocketSet m_SocketSet;
 	};
 #endif
+
+
+#if ZERODELAY_POSIXSOCKET
+	// Non blocking socket, recv waits on epoll for data (or close) up to a timeout.
+	// Opens a dual stack Ipv6 socket so that both Ipv4 and Ipv6 peers can be reached. Falls back to Ipv4 if Ipv6 is not available.
+	class PosixSocket: public ISocket
+	{
+	public:
+		static const i32_t sm_RecvWaitTimeoutMs = 100; // so that recv thread can do administration when there is no data
+		static const i32_t sm_SocketBufferSize = 4*1024*1024;
+
+		PosixSocket();
+		~PosixSocket() override;
+
+		// ISocket
+		virtual bool open(IPProto ipProto, bool reuseAddr, bool reusePort) override;
+		virtual bool bind(u16_t port) override;
+		virtual bool close() override; // wakes waiting receive threads, the descriptor is released on destruction or reopen
+		virtual ESendResult send( const struct EndPoint& endPoint, const i8_t* data, i32_t len) override;
+		virtual ERecvResult recv( i8_t* buff, i32_t& rawSize, struct EndPoint& endPoint ) override;
+		virtual ESendResult sendBatch( const Datagram* datagrams, i32_t num ) override; // sendmmsg
+		virtual ESendResult sendGather( const struct EndPoint& endPoint, const i8_t* hdr, i32_t hdrLen, const i8_t* data, i32_t len ) override; // sendmsg
+		virtual ERecvResult recvBatch( Datagram* datagrams, i32_t& num ) override;		 // recvmmsg
+
+	protected:
+		void setLastError();
+		void releaseSocket(); // only once no thread uses the socket anymore
+		const sockaddr* getSendAddr( const EndPoint& endPoint, sockaddr_in6& mapped, socklen_t& addrSize ) const;
+		i32_t m_Socket;		// not changed by close, so that a descriptor is never reused while receive threads still read it
+		i32_t m_EpollFd;
+		i32_t m_WakeupFd; // eventfd, signalled on close to return from a waiting recv
+	};
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Zerodelay.h"
+
+#include <atomic>
+
+
+namespace Zerodelay
+{
+	// Fixed capacity lock free ring to hand items from exactly one producer thread to exactly one consumer thread.
+	// Push fails when full, the producer decides whether to drop or hold on to the item.
+	template <typename T, u32_t Capacity>
+	class SpscRing
+	{
+		static_assert( Capacity > 0 && (Capacity & (Capacity-1)) == 0, "Capacity must be a power of two" );
+
+	public:
+		SpscRing():
+			m_Head(0),
+			m_Tail(0)
+		{
+		}
+
+		// ------ Called from producer -------
+
+		bool push(const T& item)
+		{
+			u32_t head = m_Head.load( std::memory_order_relaxed );
+			if ( head - m_Tail.load( std::memory_order_acquire ) == Capacity )
+				return false;
+			m_Items[head & (Capacity-1)] = item;
+			m_Head.store( head+1, std::memory_order_release );
+			return true;
+		}
+
+		// can only grow while the consumer pops
+		u32_t freeSpace() const
+		{
+			return Capacity - (m_Head.load( std::memory_order_relaxed ) - m_Tail.load( std::memory_order_acquire ));
+		}
+
+		// ------ Called from consumer -------
+
+		bool pop(T& item)
+		{
+			u32_t tail = m_Tail.load( std::memory_order_relaxed );
+			if ( tail == m_Head.load( std::memory_order_acquire ) )
+				return false;
+			item = m_Items[tail & (Capacity-1)];
+			m_Tail.store( tail+1, std::memory_order_release );
+			return true;
+		}
+
+		// ------ Any thread, only a snapshot -------
+
+		bool empty() const
+		{
+			return m_Head.load( std::memory_order_acquire ) == m_Tail.load( std::memory_order_acquire );
+		}
+
+	private:
+		T m_Items[Capacity];
+		std::atomic<u32_t> m_Head;	// next write, only written by producer
+		i8_t m_Pad[64];				// keep head and tail on different cache lines
+		std::atomic<u32_t> m_Tail;	// next read, only written by consumer
+	};
+}
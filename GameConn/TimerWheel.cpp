@@ -0,0 +1,170 @@
+#include "TimerWheel.h"
+
+#include <cassert>
+
+
+namespace Zerodelay
+{
+	TimerWheel::TimerWheel(i32_t timeNow)
+	{
+		clear( timeNow );
+	}
+
+	void TimerWheel::initTimer(Timer& timer, void* owner, i32_t kind)
+	{
+		timer.prev = nullptr;
+		timer.next = nullptr;
+		timer.list = nullptr;
+		timer.dueTS = 0;
+		timer.owner = owner;
+		timer.kind = kind;
+	}
+
+	void TimerWheel::schedule(Timer& timer, i32_t dueTS)
+	{
+		cancel( timer );
+		if ( (i32_t)((u32_t)dueTS - m_CurrentTick) > sm_MaxDelayMs ) dueTS = (i32_t)(m_CurrentTick + sm_MaxDelayMs);
+		timer.dueTS = dueTS;
+		insert( timer );
+		m_NumScheduled++;
+	}
+
+	void TimerWheel::cancel(Timer& timer)
+	{
+		if ( !timer.list )
+			return;
+		if ( timer.prev ) timer.prev->next = timer.next;
+		else *timer.list = timer.next;
+		if ( timer.next ) timer.next->prev = timer.prev;
+		timer.prev = nullptr;
+		timer.next = nullptr;
+		timer.list = nullptr;
+		m_NumScheduled--;
+	}
+
+	void TimerWheel::clear(i32_t timeNow)
+	{
+		for (auto& level : m_Slots) for (auto& slot : level) slot = nullptr;
+		m_Overdue = nullptr;
+		m_CurrentTick = (u32_t)timeNow;
+		m_NumScheduled = 0;
+	}
+
+	void TimerWheel::advance(i32_t timeNow, std::vector<Timer*>& expiredOut)
+	{
+		expire( m_Overdue, expiredOut );
+		while ( (i32_t)((u32_t)timeNow - m_CurrentTick) >= 0 )
+		{
+			if ( m_NumScheduled == 0 )
+			{
+				m_CurrentTick = (u32_t)timeNow + 1; // nothing to cascade, skip ahead
+				return;
+			}
+			u32_t idx = m_CurrentTick & (sm_NumSlots-1);
+			if ( idx == 0 )
+			{
+				// a rotation of a level completed, bring down the timers of the next slot of the level above
+				for (i32_t level=1; level<sm_NumLevels; ++level)
+				{
+					cascade( level );
+					if ( ((m_CurrentTick >> (sm_SlotBits*level)) & (sm_NumSlots-1)) != 0 )
+						break;
+				}
+			}
+			expire( m_Slots[0][idx], expiredOut );
+			m_CurrentTick++;
+		}
+	}
+
+	i32_t TimerWheel::getTimeUntilNext(i32_t timeNow) const
+	{
+		if ( m_NumScheduled == 0 )
+			return -1;
+		if ( m_Overdue )
+			return 0;
+		u32_t earliest = ~0U;
+		for (i32_t level=0; level<sm_NumLevels; ++level)
+		{
+			u32_t ticks = getEarliestInLevel( level );
+			if ( ticks < earliest ) earliest = ticks;
+		}
+		assert( earliest != ~0U );
+		i32_t timeUntil = (i32_t)(m_CurrentTick + earliest - (u32_t)timeNow);
+		return timeUntil > 0 ? timeUntil : 0;
+	}
+
+	void TimerWheel::insert(Timer& timer)
+	{
+		u32_t delay = (u32_t)timer.dueTS - m_CurrentTick;
+		i32_t level = 0;
+		while ( level < sm_NumLevels-1 && delay >= (1U << (sm_SlotBits*(level+1))) ) level++;
+		// the tick it is due at was already expired
+		Timer*& head = (i32_t)delay < 0 ? m_Overdue : m_Slots[level][((u32_t)timer.dueTS >> (sm_SlotBits*level)) & (sm_NumSlots-1)];
+		timer.prev = nullptr;
+		timer.next = head;
+		if ( head ) head->prev = &timer;
+		head = &timer;
+		timer.list = &head;
+	}
+
+	void TimerWheel::cascade(i32_t level)
+	{
+		Timer*& head = m_Slots[level][(m_CurrentTick >> (sm_SlotBits*level)) & (sm_NumSlots-1)];
+		Timer* timer = head;
+		head = nullptr; // detach first, a timer a full rotation ahead goes back into this slot
+		while ( timer )
+		{
+			Timer* next = timer->next;
+			insert( *timer );
+			timer = next;
+		}
+	}
+
+	void TimerWheel::expire(Timer*& list, std::vector<Timer*>& expiredOut)
+	{
+		Timer* timer = list;
+		list = nullptr;
+		while ( timer )
+		{
+			Timer* next = timer->next;
+			timer->prev = nullptr;
+			timer->next = nullptr;
+			timer->list = nullptr;
+			m_NumScheduled--;
+			expiredOut.emplace_back( timer );
+			timer = next;
+		}
+	}
+
+	u32_t TimerWheel::getEarliestInLevel(i32_t level) const
+	{
+		// level 0 slots hold a single tick
+		if ( level == 0 )
+		{
+			for (u32_t i=0; i<(u32_t)sm_NumSlots; ++i)
+			{
+				if ( m_Slots[0][(m_CurrentTick + i) & (sm_NumSlots-1)] )
+					return i;
+			}
+			return ~0U;
+		}
+		// the current slot may not be cascaded yet or hold timers a full rotation ahead, otherwise slots are in order
+		u32_t current = (m_CurrentTick >> (sm_SlotBits*level)) & (sm_NumSlots-1);
+		u32_t earliest = ~0U;
+		for (u32_t i=0; i<(u32_t)sm_NumSlots; ++i)
+		{
+			const Timer* timer = m_Slots[level][(current + i) & (sm_NumSlots-1)];
+			if ( !timer )
+				continue;
+			for (; timer; timer = timer->next)
+			{
+				u32_t ticks = (u32_t)timer->dueTS - m_CurrentTick;
+				if ( (i32_t)ticks < 0 ) ticks = 0;
+				if ( ticks < earliest ) earliest = ticks;
+			}
+			if ( i > 0 )
+				break;
+		}
+		return earliest;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Zerodelay.h"
+
+#include <vector>
+
+
+namespace Zerodelay
+{
+	// Hierarchical timing wheel (Varghese & Lauck) with a resolution of 1ms.
+	// Level 0 has a slot per millisecond, each next level has slots that span a full rotation of the level below.
+	// Timers far away sit in a coarse level and move down when their slot comes up, so expiring only touches due timers.
+	// Timers are intrusive (owned by the caller), scheduling and cancelling is O(1) and does not allocate.
+	// Not thread safe.
+	class TimerWheel
+	{
+	public:
+		static const i32_t sm_NumLevels = 4;
+		static const i32_t sm_SlotBits  = 6;
+		static const i32_t sm_NumSlots  = 1 << sm_SlotBits;
+		static const i32_t sm_MaxDelayMs = (1 << (sm_NumLevels*sm_SlotBits)) - 1; // about 4.6 hours, longer delays are clamped
+
+		struct Timer
+		{
+			Timer* prev;
+			Timer* next;
+			Timer** list;	// slot it is in, nullptr if not scheduled
+			i32_t dueTS;
+			void* owner;
+			i32_t kind;
+		};
+
+		TimerWheel( i32_t timeNow );
+
+		static void initTimer( Timer& timer, void* owner, i32_t kind );
+		static bool isScheduled( const Timer& timer ) { return timer.list != nullptr; }
+
+		void schedule( Timer& timer, i32_t dueTS );	// moves it if already scheduled, if overdue it expires on next advance
+		void cancel( Timer& timer );
+		void clear( i32_t timeNow );				// forgets all timers without touching them
+		void advance( i32_t timeNow, std::vector<Timer*>& expiredOut ); // appends due timers, these are no longer scheduled
+		i32_t getTimeUntilNext( i32_t timeNow ) const; // 0 if overdue, -1 if nothing scheduled
+
+	private:
+		void insert( Timer& timer );
+		void cascade( i32_t level );
+		void expire( Timer*& list, std::vector<Timer*>& expiredOut );
+		u32_t getEarliestInLevel( i32_t level ) const; // ticks from current, ~0U if level is empty
+
+		Timer* m_Slots[sm_NumLevels][sm_NumSlots];
+		Timer* m_Overdue;		// scheduled at or before a tick that already expired
+		u32_t m_CurrentTick;	// next tick to expire
+		i32_t m_NumScheduled;
+	};
+}
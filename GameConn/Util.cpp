@@ -2,6 +2,7 @@
 #include "Platform.h"
 
 #include <cassert>
+#include <chrono>
 
 
 namespace Zerodelay
@@ -103,15 +104,15 @@ namespace Zerodelay
 
 	i32_t Util::timeNow()
 	{
-		clock_t now = ::clock();
-		return now;
+		// Wall time (monotonic) since first call. ::clock() measures cpu time on some platforms which makes it useless for round trip measurements.
+		static const auto startTime = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::steady_clock::now() - startTime;
+		return (i32_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
 	}
 
 	i32_t Util::getTimeSince(i32_t timestamp)
 	{
-		clock_t now = ::clock();
-		float elapsedSeconds = float(now - timestamp) / (float)CLOCKS_PER_SEC;
-		return i32_t(elapsedSeconds * 1000.f);
+		return timeNow() - timestamp;
 	}
 
 
@@ -152,4 +153,13 @@ namespace Zerodelay
 		deliveryTraceOut->emplace_back(t);
 	}
 
+	ESendCallResult Util::combineSendResults(ESendCallResult combined, ESendCallResult individual)
+	{
+		if ( individual == ESendCallResult::Succes || combined == ESendCallResult::Succes )
+			return ESendCallResult::Succes;
+		if ( individual == ESendCallResult::WouldBlock || combined == ESendCallResult::WouldBlock )
+			return ESendCallResult::WouldBlock;
+		return combined;
+	}
+
 }
\ No newline at end of file
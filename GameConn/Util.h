@@ -31,12 +31,13 @@ namespace Zerodelay
 		static u16_t htons( u16_t val );
 		static u32_t ntohl( u32_t val ) { return htonl(val); }
 		static u16_t ntohs( u16_t val ) { return htons(val); }
-		static i32_t timeNow();
+		static i32_t timeNow();						 // in milliseconds
 		static i32_t getTimeSince(i32_t timestamp);  // in milliseconds
 
 		static bool deserializeMap( std::map<std::string, std::string>& data, const i8_t* source, i32_t payloadLenIn );
 
 		static void addTraceCallResult( std::vector<ZAckTicket>* deliveryTraceOut, const EndPoint& etp, ETraceCallResult, u32_t sequence, u32_t numFragments,  i8_t channel );
+		static ESendCallResult combineSendResults( ESendCallResult combined, ESendCallResult individual ); // succes if any is sent, else would block if any is full
 
 		template <typename List, typename Callback>
 		static void bindCallback( List& list, const Callback& cb );
@@ -51,28 +52,29 @@ namespace Zerodelay
 		static void read32(const i8_t* buff, i32_t& b)		{ b = ntohl( *(i32_t*)buff ); }
 
 		template <typename T> 
-		static void write(i8_t* buff, const T& val) { static_assert(false, "Invalid parameter for T"); return false; }
+		static void write(i8_t* buff, const T& val) { static_assert(sizeof(T)==0, "Invalid parameter for T"); }
 		template <typename T>
-		static void read(const i8_t* buff, T& val) { static_assert(false, "Invalid parameter for T"); return false; }
-
-		template <> static void write(i8_t* buff, const bool& b)  { write8(buff, (i8_t&)b); }
-		template <> static void write(i8_t* buff, const i8_t& b)  { write8(buff, b); }
-		template <> static void write(i8_t* buff, const i16_t& b) { write16(buff, b); }
-		template <> static void write(i8_t* buff, const i32_t& b) { write32(buff, b); }
-		template <> static void write(i8_t* buff, const u8_t& b)  { write8(buff, (const i8_t&)b); }
-		template <> static void write(i8_t* buff, const u16_t& b) { write16(buff, (const i16_t&)b); }
-		template <> static void write(i8_t* buff, const u32_t& b) { write32(buff, (const i32_t&)b); }
-					 
-		template <> static void read(const i8_t* buff, bool& b)  { read8(buff, (i8_t&)b); }
-		template <> static void read(const i8_t* buff, i8_t& b)  { read8(buff, b); }
-		template <> static void read(const i8_t* buff, i16_t& b) { read16(buff, b); }
-		template <> static void read(const i8_t* buff, i32_t& b) { read32(buff, b); }
-		template <> static void read(const i8_t* buff, u8_t& b)  { read8(buff, (i8_t&)b); }
-		template <> static void read(const i8_t* buff, u16_t& b) { read16(buff, (i16_t&)b); }
-		template <> static void read(const i8_t* buff, u32_t& b) { read32(buff, (i32_t&)b); }
+		static void read(const i8_t* buff, T& val) { static_assert(sizeof(T)==0, "Invalid parameter for T"); }
 	};
 
 
+	template <> inline void Util::write(i8_t* buff, const bool& b)  { write8(buff, (i8_t&)b); }
+	template <> inline void Util::write(i8_t* buff, const i8_t& b)  { write8(buff, b); }
+	template <> inline void Util::write(i8_t* buff, const i16_t& b) { write16(buff, b); }
+	template <> inline void Util::write(i8_t* buff, const i32_t& b) { write32(buff, b); }
+	template <> inline void Util::write(i8_t* buff, const u8_t& b)  { write8(buff, (const i8_t&)b); }
+	template <> inline void Util::write(i8_t* buff, const u16_t& b) { write16(buff, (const i16_t&)b); }
+	template <> inline void Util::write(i8_t* buff, const u32_t& b) { write32(buff, (const i32_t&)b); }
+				 
+	template <> inline void Util::read(const i8_t* buff, bool& b)  { read8(buff, (i8_t&)b); }
+	template <> inline void Util::read(const i8_t* buff, i8_t& b)  { read8(buff, b); }
+	template <> inline void Util::read(const i8_t* buff, i16_t& b) { read16(buff, b); }
+	template <> inline void Util::read(const i8_t* buff, i32_t& b) { read32(buff, b); }
+	template <> inline void Util::read(const i8_t* buff, u8_t& b)  { read8(buff, (i8_t&)b); }
+	template <> inline void Util::read(const i8_t* buff, u16_t& b) { read16(buff, (i16_t&)b); }
+	template <> inline void Util::read(const i8_t* buff, u32_t& b) { read32(buff, (i32_t&)b); }
+
+
 	template <typename List, typename Callback>
 	void Util::bindCallback(List& list, const Callback& cb)
 	{
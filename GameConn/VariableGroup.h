@@ -1,6 +1,6 @@
 #pragma once
 
-#include "NetVar.h"
+#include "Netvar.h"
 #include <vector>
 
 
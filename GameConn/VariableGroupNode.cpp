@@ -370,11 +370,9 @@ namespace Zerodelay
 		// Request new id's when necessary and only if at least a single connection is connected.
 		if ( (m_ZNode->getNumOpenConnections() > 0) && ((i32_t)m_UniqueIds.size() < sm_AvailableIds) )
 		{
-			clock_t tNow = ::clock();
-			float dt = (float)(tNow - m_LastIdPackRequestTS) / (float)CLOCKS_PER_SEC;
-			if ( dt >= .5f )
+			if ( Util::getTimeSince( m_LastIdPackRequestTS ) >= 500 )
 			{
-				m_LastIdPackRequestTS = tNow;
+				m_LastIdPackRequestTS = Util::timeNow();
 				// Send unreliable sequenced, because it is possible that at the time of sending the data, no connections
 				// are fully connected anymore in which case the reliable ordered packet becomes unreliable.
 				m_ZNode->sendUnreliableSequenced((u8_t)EDataPacketType::IdPackRequest, nullptr, 0, nullptr, false, 0, false, true);
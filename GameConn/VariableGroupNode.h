@@ -110,7 +110,7 @@ namespace Zerodelay
 		std::vector<GroupCreateData> m_BufferedGroups;				// When created, keep list so that new incoming connections can get the till then created buffered list of variable groups.
 		std::map<u32_t, class VariableGroup*> m_VariableGroups;		// Variable groups on this local endpoint.
 		std::map<EndPoint, std::map<u32_t, class VariableGroup*>, EndPoint::STLCompare> m_RemoteVariableGroups; // variable groups per connection of remote machines
-		clock_t m_LastIdPackRequestTS;
+		i32_t   m_LastIdPackRequestTS;
 		u32_t   m_UniqueIdCounter;
 		std::vector<GroupCallback> m_GroupUpdateCallbacks;
 		std::vector<GroupCallback> m_GroupDestroyCallbacks;
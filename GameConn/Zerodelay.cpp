@@ -7,6 +7,7 @@
 #include "ConnectionNode.h"
 #include "VariableGroupNode.h"
 #include "MasterServer.h"
+#include "PacketPool.h"
 
 
 namespace Zerodelay
@@ -30,6 +31,42 @@ namespace Zerodelay
 		return (const EndPoint*)z;
 	}
 
+	// sends on each connected link with the given delivery type, or raw on each link if no connection is required
+	ESendCallResult sendToConnections(CoreNode* C, EHeaderPacketType type, u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific, bool exclude, u8_t channel, bool relay, bool requiresConnection, u32_t subStream=0)
+	{
+		ESendCallResult sendResult = ESendCallResult::NotSent;
+		if (requiresConnection)
+		{
+			// payload is built once if the message goes to multiple connections
+			const i8_t* sharedPayload = nullptr;
+			if ( (!specific || exclude) && C->cn()->getNumOpenConnections() > 1 )
+			{
+				sharedPayload = RUDPLink::allocSharedPayload( type, data, len );
+			}
+			C->cn()->forConnections(asEpt(specific), exclude, [&](Connection& c)
+			{
+				if (!c.isConnected()) return;
+				ESendCallResult individualResult = c.getLink()->addToSendQueue( packId, data, len, type, channel, relay, nullptr, nullptr, subStream, sharedPayload );
+				sendResult = Util::combineSendResults( sendResult, individualResult );
+			});
+			PacketPool::release( sharedPayload );
+		}
+		else // send raw without requiring a connection
+		{
+			ISocket* sock = C->rn()->getSocket();
+			if ( sock )
+			{
+			 	sendResult = C->rn()->send( packId, data, len, asEpt(specific), exclude, type, channel, relay, nullptr, subStream );
+			}
+			else
+			{
+				C->setCriticalError(ECriticalError::SocketIsNull, ZERODELAY_FUNCTION_LINE);
+				sendResult = ESendCallResult::InternalError;
+			}
+		}
+		return sendResult;
+	}
+
 
 	// -------- End Support ----------------------------------------------------------------------------------------------
 
@@ -248,7 +285,6 @@ namespace Zerodelay
 		while (link)
 		{
 			C->cn()->beginProcessPacketsFor(link->getEndPoint());
-			link->beginPoll();
 			Packet pack;
 			while (link->poll(pack))
 			{
@@ -260,9 +296,8 @@ namespace Zerodelay
 						C->processUnhandledPacket(pack, link->getEndPoint());
 					}
 				}
-				delete [] pack.data;
+				PacketPool::release( pack.buffer );
 			}
-			link->endPoll();
 			C->cn()->endProcessPackets();
 			C->rn()->unpinLink(link);
 			link = C->rn()->getLinkAndPinIt(++linkIdx);
@@ -270,6 +305,14 @@ namespace Zerodelay
 
 		C->cn()->update();
 		C->vgn()->update();
+
+		// send what was generated this frame in as few datagrams as possible
+		C->rn()->flush();
+	}
+
+	void ZNode::flush()
+	{
+		C->rn()->flush();
 	}
 
 	void ZNode::setPassword(const std::string& pw)
@@ -307,12 +350,63 @@ namespace Zerodelay
 		C->rn()->simulatePacketLoss( percentage );
 	}
 
+	void ZNode::setReliableWindowSize(u32_t numFragments)
+	{
+		C->rn()->setReliableWindow( numFragments );
+	}
+
+	void ZNode::setCongestionControl(ECongestionControl type)
+	{
+		C->rn()->setCongestionControl( type );
+	}
+
+	void ZNode::setCoalesceDelay(u32_t delayMs)
+	{
+		C->rn()->setCoalesceDelay( delayMs );
+	}
+
+	void ZNode::setUnreliableFec(u8_t channel, u32_t groupSize)
+	{
+		C->rn()->setFecGroupSize( channel, groupSize );
+	}
+
+	void ZNode::setUnreliableRedundancy(u8_t channel, u32_t numPrevious)
+	{
+		C->rn()->setRedundancy( channel, numPrevious );
+	}
+
+	void ZNode::setLowLatency(bool enabled)
+	{
+		C->rn()->setLowLatency( enabled );
+	}
+
+	void ZNode::setNumReceiveThreads(u32_t numThreads)
+	{
+		C->rn()->setNumRecvThreads( numThreads );
+	}
+
+	void ZNode::setSendQueueBudget(u32_t maxBytes, u32_t maxMessages)
+	{
+		C->rn()->setSendBudget( -1, maxBytes, maxMessages );
+	}
+
+	void ZNode::setChannelSendQueueBudget(u8_t channel, u32_t maxBytes, u32_t maxMessages)
+	{
+		C->rn()->setSendBudget( channel, maxBytes, maxMessages );
+	}
+
 	ESendCallResult ZNode::sendReliableOrdered(u8_t id, const i8_t* data, i32_t len, const ZEndpoint* specific, bool exclude, u8_t channel, 
 											   bool relay, bool requiresConnection, std::vector<ZAckTicket>* deliveryTraceOut)
 	{
 		ESendCallResult sendResult = ESendCallResult::NotSent;
 		if (requiresConnection)
 		{
+			// payload is built once if the message goes to multiple connections
+			const i8_t* sharedPayload = nullptr;
+			if ( (!specific || exclude) && C->cn()->getNumOpenConnections() > 1 )
+			{
+				sharedPayload = RUDPLink::allocSharedPayload( EHeaderPacketType::Reliable_Ordered, data, len );
+			}
 			C->cn()->forConnections(asEpt(specific), exclude, [&](Connection& c)
 			{
 				if (!c.isConnected())
@@ -323,21 +417,20 @@ namespace Zerodelay
 				ESendCallResult individualSendResult;
 				if ( deliveryTraceOut )
 				{
-					u32_t sequence;
-					u32_t numFragments;
-					individualSendResult = c.getLink()->addToSendQueue( id, data, len, EHeaderPacketType::Reliable_Ordered, channel, relay, &sequence, &numFragments );
-					Util::addTraceCallResult( deliveryTraceOut, c.getEndPoint(), ETraceCallResult::Tracking, sequence, numFragments, channel );
+					u32_t sequence = 0;
+					u32_t numFragments = 0;
+					individualSendResult = c.getLink()->addToSendQueue( id, data, len, EHeaderPacketType::Reliable_Ordered, channel, relay, &sequence, &numFragments, 0, sharedPayload );
+					ETraceCallResult traceResult = individualSendResult == ESendCallResult::WouldBlock ? ETraceCallResult::WouldBlock : ETraceCallResult::Tracking;
+					Util::addTraceCallResult( deliveryTraceOut, c.getEndPoint(), traceResult, sequence, numFragments, channel );
 				}
 				else
 				{
-					individualSendResult = c.getLink()->addToSendQueue( id, data, len, EHeaderPacketType::Reliable_Ordered, channel, relay );
+					individualSendResult = c.getLink()->addToSendQueue( id, data, len, EHeaderPacketType::Reliable_Ordered, channel, relay, nullptr, nullptr, 0, sharedPayload );
 				}
 				// If at least a single is sent to, consider succes call
-				if ( sendResult == ESendCallResult::NotSent && individualSendResult == ESendCallResult::Succes ) 
-				{
-					sendResult = ESendCallResult::Succes;
-				}
+				sendResult = Util::combineSendResults( sendResult, individualSendResult );
 			});
+			PacketPool::release( sharedPayload );
 		}
 		else
 		{
@@ -384,33 +477,27 @@ namespace Zerodelay
 
 	ESendCallResult ZNode::sendUnreliableSequenced(u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific, bool exclude, u8_t channel, bool relay, bool requiresConnection)
 	{
-		ESendCallResult sendResult = ESendCallResult::NotSent;
-		if (requiresConnection)
-		{
-			C->cn()->forConnections(asEpt(specific), exclude, [&](Connection& c)
-			{
-				if (!c.isConnected()) return;
-				ESendCallResult individualResult = c.getLink()->addToSendQueue( packId, data, len, EHeaderPacketType::Unreliable_Sequenced, channel, relay );
-				if ( sendResult == ESendCallResult::NotSent && individualResult == ESendCallResult::Succes )
-				{
-					sendResult = ESendCallResult::Succes;
-				}
-			});
-		}
-		else // send raw without requiring a connection
-		{
-			ISocket* sock = C->rn()->getSocket();
-			if ( sock )
-			{
-			 	sendResult = C->rn()->send( packId, data, len, asEpt(specific), exclude, EHeaderPacketType::Unreliable_Sequenced, channel, relay );
-			}
-			else
-			{
-				C->setCriticalError(ECriticalError::SocketIsNull, ZERODELAY_FUNCTION_LINE);
-				sendResult = ESendCallResult::InternalError;
-			}
-		}
-		return sendResult;
+		return sendToConnections( C, EHeaderPacketType::Unreliable_Sequenced, packId, data, len, specific, exclude, channel, relay, requiresConnection );
+	}
+
+	ESendCallResult ZNode::sendReliableUnordered(u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific, bool exclude, u8_t channel, bool relay, bool requiresConnection)
+	{
+		return sendToConnections( C, EHeaderPacketType::Reliable_Unordered, packId, data, len, specific, exclude, channel, relay, requiresConnection );
+	}
+
+	ESendCallResult ZNode::sendUnreliable(u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific, bool exclude, u8_t channel, bool relay, bool requiresConnection)
+	{
+		return sendToConnections( C, EHeaderPacketType::Unreliable, packId, data, len, specific, exclude, channel, relay, requiresConnection );
+	}
+
+	ESendCallResult ZNode::sendReliableSubStream(u8_t packId, const i8_t* data, i32_t len, u32_t subStream, const ZEndpoint* specific, bool exclude, u8_t channel, bool relay, bool requiresConnection)
+	{
+		return sendToConnections( C, EHeaderPacketType::Reliable_SubStream, packId, data, len, specific, exclude, channel, relay, requiresConnection, subStream );
+	}
+
+	ESendCallResult ZNode::sendUnreliableRedundant(u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific, bool exclude, u8_t channel, bool relay, bool requiresConnection)
+	{
+		return sendToConnections( C, EHeaderPacketType::Unreliable_Redundant, packId, data, len, specific, exclude, channel, relay, requiresConnection );
 	}
 
 	void ZNode::bindOnCustomData(const std::function<void (const ZEndpoint&, u8_t id, const i8_t* data, i32_t length, u8_t channel)>& cb)
@@ -483,6 +570,38 @@ namespace Zerodelay
 		return C->rn()->isPacketDelivered(ticket.endpoint, ticket.sequence, ticket.numFragments, ticket.channel);
 	}
 
+	i32_t ZNode::getLatency(const ZEndpoint& ztp) const
+	{
+		u32_t latency, variance;
+		if ( C->rn()->getLatency(ztp, latency, variance) )
+			return (i32_t)latency;
+		return -1;
+	}
+
+	i32_t ZNode::getLatencyVariance(const ZEndpoint& ztp) const
+	{
+		u32_t latency, variance;
+		if ( C->rn()->getLatency(ztp, latency, variance) )
+			return (i32_t)variance;
+		return -1;
+	}
+
+	i32_t ZNode::getQueuedSendBytes(const ZEndpoint& ztp, i32_t channel) const
+	{
+		u32_t bytes, messages;
+		if ( C->rn()->getQueuedSend(ztp, channel, bytes, messages) )
+			return (i32_t)bytes;
+		return -1;
+	}
+
+	i32_t ZNode::getQueuedSendMessages(const ZEndpoint& ztp, i32_t channel) const
+	{
+		u32_t bytes, messages;
+		if ( C->rn()->getQueuedSend(ztp, channel, bytes, messages) )
+			return (i32_t)messages;
+		return -1;
+	}
+
 	void ZNode::deferredCreateVariableGroup(const i8_t* paramData, i32_t paramDataLen)
 	{
 		C->vgn()->deferredCreateGroup( paramData, paramDataLen );
@@ -148,10 +148,24 @@ namespace Zerodelay
 				3. The destination was a closed connection and therefore the send was blocked. 
 				4. Paramater data was inappropriate for the function question. Eg: calling a function with a nullptr where this is not allowed. */
 		NotSent,
+		/*	The send queue budget of the connection or channel is full (see setSendQueueBudget). Nothing was queued,
+			try again later or drop the message. With multiple destinations, returned if none accepted it and at least one was full. */
+		WouldBlock,
 		/*	See log for more info. */
 		InternalError
 	};
 
+	enum class ECongestionControl
+	{
+		/*	No congestion control and no pacing. Reliable data is sent as fast as the reliable window allows. Default. */
+		None,
+		/*	Window grows until packets get lost and halves on loss (AIMD). Throughput collapses on links with random (non congestion) loss. */
+		NewReno,
+		/*	Window shrinks as soon as the round trip time increases due to queuing in routers. Keeps latency low 
+			on shared uplinks but gets a smaller share of the bandwidth when competing with loss based flows. */
+		DelayBased
+	};
+
 	enum class ETraceCallResult
 	{
 		/*  If the packet can be tracked, this is set. However, to see if a packet is delivered use: 
@@ -164,6 +178,8 @@ namespace Zerodelay
 		ConnectionWasRequired,
 		/*	If calling this function after disconnect, this is set. */
 		SendingIsBlocked,
+		/*	The send queue budget of the connection or channel was full, the packet was not sent. */
+		WouldBlock,
 		/*	Other internal error, see log. */
 		InternalError
 	};
@@ -335,10 +351,15 @@ namespace Zerodelay
 
 
 		/*	This will invoke the bound callback functions when new data is available. 
-			Usually called every frame update in a game. */
+			Usually called every frame update in a game. 
+			Also flushes all messages that were coalesced during the frame. */
 		void update();
 
 
+		/*	Sends all messages that are being coalesced now instead of waiting for the coalesce delay. */
+		void flush();
+
+
 		/*	The password that is required to connect to this node. 
 			Default is empty string. */
 		void setPassword( const std::string& pw );
@@ -367,6 +388,69 @@ namespace Zerodelay
 		void simulatePacketLoss( u32_t percentage );
 
 
+		/*	Maximum number of unacknowledged reliable ordered fragments in flight per channel per connection. 
+			Is rounded up to a power of two. Fragments that do not fit are queued and sent when acks arrive.
+			Only applies to connections that are made afterwards. Default is 512. */
+		void setReliableWindowSize( u32_t numFragments );
+
+
+		/*	Congestion control algorithm that limits the amount of reliable data in flight per connection. 
+			Reliable data is also paced over the round trip time instead of sent in bursts.
+			Unreliable data is not held back. Only applies to connections that are made afterwards. 
+			Default is None, so out of the box reliable data is neither limited to a window nor paced. This is deliberate, game traffic 
+			is mostly small and latency bound, and loss based control stalls on the random loss of wireless links. Choose NewReno or 
+			DelayBased when sending bulk data over shared links. */
+		void setCongestionControl( ECongestionControl type );
+
+
+		/*	Small messages to the same connection are coalesced into a single datagram for at most this amount of ms 
+			or until update() or flush() is called. This reduces per packet overhead. Set to 0 to send each message immediately. 
+			Default is 2ms. */
+		void setCoalesceDelay( u32_t delayMs );
+
+
+		/*	Forward error correction for unreliable sequenced messages on a channel. After every groupSize messages a parity
+			packet is sent (overhead is 1/groupSize), from which the receiver rebuilds a single lost message of the group
+			without waiting for a resend. Like any sequenced message, a rebuilt message is dropped if a newer one was delivered already.
+			Messages that are fragmented are not protected. Max group size is 32, 0 turns it off.
+			Only applies to connections that are made afterwards. Default is off. */
+		void setUnreliableFec( u8_t channel, u32_t groupSize );
+
+
+		/*	Number of previous unacknowledged messages that are repeated in each datagram of sendUnreliableRedundant on a channel.
+			The repeats are delta encoded against each other, so nearly identical input costs a few bytes each. Max is 32.
+			Only applies to connections that are made afterwards. Default is 8. */
+		void setUnreliableRedundancy( u8_t channel, u32_t numPrevious );
+
+
+		/*	Number of sockets that are opened on the listen port, each with its own receive thread. The kernel spreads 
+			the connections over them (SO_REUSEPORT), so that receiving scales over multiple cores with many connections.
+			Only applies to a listen on a specific port called afterwards. Only supported on Linux. Default is 1. */
+		void setNumReceiveThreads( u32_t numThreads );
+
+
+		/*	Limits the reliable user messages (id >= USER_ID_OFFSET) that can be queued for a connection, that is unacked
+			or waiting for room in the window. A send that does not fit returns WouldBlock, so that a slow or dead connection 
+			cannot make memory grow until it times out. A single message that is larger than the budget is accepted if nothing is queued.
+			Reliable newest data counts in the byte budget of the connection, a new group that does not fit is dropped.
+			[maxBytes]		0 is unlimited. Default is 8MB.
+			[maxMessages]	0 is unlimited. Default is 16384.
+			Only applies to connections that are made afterwards. */
+		void setSendQueueBudget( u32_t maxBytes, u32_t maxMessages );
+
+
+		/*	Same as setSendQueueBudget, but for a channel only. Ordered, unordered and sub-stream messages of the channel count together.
+			Only applies to connections that are made afterwards. Default is unlimited. */
+		void setChannelSendQueueBudget( u8_t channel, u32_t maxBytes, u32_t maxMessages );
+
+
+		/*	In low latency mode, acks, reliable newest changes and coalesced messages are sent as soon as the send thread 
+			gets to them, instead of after the ack aggregate time, reliable newest interval or coalesce delay. 
+			What piles up until then still goes out together, and acks are piggybacked on data that leaves at the same time. 
+			Costs more packets when many small messages are sent spread over time. Default is off. */
+		void setLowLatency( bool enabled );
+
+
 		/*	Messages are guarenteed to arrive and also in the order they were sent. This applies per channel.
 			[packId]	Id of message. Should start from USER_ID_OFFSET, see above.
 			[data]		Actual payload of message.
@@ -376,6 +460,7 @@ namespace Zerodelay
 						- If not nullptr and exclude is true, then message is sent to all except the specific.
 			[channel]	On what channel to sent the message. Packets are sequenced and ordered per channel. Max of 8 channels, 0 to 7.
 			[relay]		Whether to relay the message to other connected clients when it arrives. 
+						The server relays it from its receive thread, so without waiting for its update. 
 			[requiresConnection] If false, the packet is sent regardless of whether the endpoint(s) are in connected state. Default true. 
 			[deliveryTraceOut]  If not null, for every endpoint the packet is sent, a ticket is stored which can be used to
 								check if the packet was delivered at the designated endpoint. */
@@ -409,6 +494,36 @@ namespace Zerodelay
 		ESendCallResult sendUnreliableSequenced( u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific=nullptr, bool exclude=false, u8_t channel=0, bool relay=true, bool requiresConnection=true );
 
 
+		/*	Messages are guarenteed to arrive but are delivered as soon as they are complete, not in the order they were sent.
+			A lost message therefore does not hold back messages sent after it. Parameters are the same as for sendUnreliableSequenced.
+			Unordered messages on a channel do not wait for, nor hold back, ordered messages on the same channel.
+			Requires that the remote runs a version that knows this delivery type, older versions drop the messages. */
+		ESendCallResult sendReliableUnordered( u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific=nullptr, bool exclude=false, u8_t channel=0, bool relay=true, bool requiresConnection=true );
+
+
+		/*	Messages are unreliable and unsequenced. Packets may get lost or arrive out of order, older packets are not dropped.
+			Parameters are the same as for sendUnreliableSequenced.
+			Requires that the remote runs a version that knows this delivery type, older versions drop the messages. */
+		ESendCallResult sendUnreliable( u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific=nullptr, bool exclude=false, u8_t channel=0, bool relay=true, bool requiresConnection=true );
+
+
+		/*	Messages are guarenteed to arrive and in the order they were sent on the same sub-stream, for instance one per game object.
+			Sub-streams are independent, so a lost message only holds back later messages of its own sub-stream.
+			Any number of sub-streams can be used, they take no memory while all their messages are acknowledged.
+			[subStream]	Any id, only ordered relative to other messages with the same id on the same channel.
+			Other parameters are the same as for sendUnreliableSequenced. Adds 8 bytes to the message.
+			Requires that the remote runs a version that knows this delivery type, older versions drop the messages. */
+		ESendCallResult sendReliableSubStream( u8_t packId, const i8_t* data, i32_t len, u32_t subStream, const ZEndpoint* specific=nullptr, bool exclude=false, u8_t channel=0, bool relay=true, bool requiresConnection=true );
+
+
+		/*	Meant for player input. Each datagram also carries the previous unacknowledged messages (see setUnreliableRedundancy),
+			so a lost datagram is recovered by the next one without waiting for a resend. Messages are sequenced and arrive at most once,
+			a message is only lost if all datagrams that carried it are lost. Messages are not fragmented, so must fit in a single datagram.
+			The datagram is sent right away, it is not coalesced. Parameters are the same as for sendUnreliableSequenced.
+			Requires that the remote runs a version that knows this delivery type, older versions drop the messages. */
+		ESendCallResult sendUnreliableRedundant( u8_t packId, const i8_t* data, i32_t len, const ZEndpoint* specific=nullptr, bool exclude=false, u8_t channel=0, bool relay=true, bool requiresConnection=true );
+
+
 		/*	----- Variable Group Callbacks ----------------------------------------------------------------------------------------------- */
 
 			/*	If at least a single variable inside the group is updated, this callback is invoked.
@@ -449,6 +564,26 @@ namespace Zerodelay
 		bool isPacketDelivered(const ZAckTicket& ticket) const;
 
 
+		/*	Returns the smoothed round trip time in milliseconds to the endpoint, measured from acknowledged reliable packets.
+			Until the first ack is measured, an initial estimate is returned. Returns -1 if the endpoint is not known. */
+		i32_t getLatency(const ZEndpoint& ztp) const;
+
+
+		/*	Returns the round trip time variance (jitter) in milliseconds to the endpoint. Returns -1 if the endpoint is not known. */
+		i32_t getLatencyVariance(const ZEndpoint& ztp) const;
+
+
+		/*	Returns the bytes of reliable data that are queued for the endpoint, unacked or waiting for room in the window, including 
+			headers. Channel -1 is all channels plus unacked reliable newest data. Returns -1 if the endpoint is not known. 
+			Use it to shed low priority traffic before sends would block. */
+		i32_t getQueuedSendBytes(const ZEndpoint& ztp, i32_t channel=-1) const;
+
+
+		/*	Returns the number of reliable messages that are queued for the endpoint. Channel -1 is all channels.
+			Returns -1 if the endpoint is not known. */
+		i32_t getQueuedSendMessages(const ZEndpoint& ztp, i32_t channel=-1) const;
+
+
 	
 
 		/*	--- !!! FOR INTERNAL USES !!! --- */
@@ -311,9 +311,6 @@ namespace UnitTests
 		ZNode* g1 = new ZNode( 33, 8, -1);
 		ZNode* g2 = new ZNode( 33, 8, -1);
 
-		if (Unreliable) g2->simulatePacketLoss(0);
-		else g2->simulatePacketLoss(PackLoss);
-
 		g1->connect( "localhost", 27000 );
 		EListenCallResult listenResult = g2->listen( 27000 );
 		switch ( listenResult)
@@ -344,6 +341,10 @@ namespace UnitTests
 			}
 		}
 
+		// loss only applies to open connections
+		if (Unreliable) g2->simulatePacketLoss(0);
+		else g2->simulatePacketLoss(PackLoss);
+
 		int kSends = NumSends;
 		static const int nch = 8;
 
@@ -476,6 +477,618 @@ namespace UnitTests
 	}
 
 
+	//////////////////////////////////////////////////////////////////////////
+	// Shared by the delivery tests
+	//////////////////////////////////////////////////////////////////////////
+
+	// Test message: seq | len | key (channel or sub-stream) | bytes that follow from seq and key, so that any corruption shows.
+	static const int TestMsgHdrSize = 12;
+
+	static void WriteTestMessage( char* data, int len, int seq, int key )
+	{
+		*(int*)data = seq;
+		*(int*)(data + 4) = len;
+		*(int*)(data + 8) = key;
+		for ( int i=TestMsgHdrSize; i<len; i++ )
+			data[i] = (char)(seq*31 + key*7 + i);
+	}
+
+	static bool ReadTestMessage( const char* data, int len, int& seq, int& key )
+	{
+		if ( len < TestMsgHdrSize || *(int*)(data + 4) != len )
+			return false;
+		seq = *(int*)data;
+		key = *(int*)(data + 8);
+		for ( int i=TestMsgHdrSize; i<len; i++ )
+		{
+			if ( data[i] != (char)(seq*31 + key*7 + i) )
+				return false;
+		}
+		return true;
+	}
+
+	static bool ConnectTestNodes( BaseTest* test, ZNode* server, const std::vector<ZNode*>& clients, int port )
+	{
+		server->listen( port );
+		for ( auto* c : clients )
+			c->connect( "localhost", port );
+		int kTicks = 0;
+		while ( true )
+		{
+			bool bConnected = server->getNumOpenConnections() == (int)clients.size();
+			for ( auto* c : clients )
+				bConnected = bConnected && c->getNumOpenConnections() == 1;
+			if ( bConnected )
+				return true;
+			server->update();
+			for ( auto* c : clients )
+				c->update();
+			std::this_thread::sleep_for(50ms);
+			if ( kTicks++ == 100 )
+			{
+				printf("FAILED connecting in %s\n", test->Name.c_str());
+				test->Result = false;
+				return false;
+			}
+		}
+	}
+
+	static void CloseTestNodes( const std::vector<ZNode*>& nodes )
+	{
+		for ( auto* n : nodes )
+			n->disconnect();
+		// let the disconnects go out
+		for ( int kTicks=0; kTicks<200; kTicks++ )
+		{
+			bool bPending = false;
+			for ( auto* n : nodes )
+			{
+				n->update();
+				bPending = bPending || n->hasPendingData();
+			}
+			if ( !bPending )
+				break;
+			std::this_thread::sleep_for(5ms);
+		}
+		for ( auto* n : nodes )
+			delete n;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Delivery Mode Test
+	//////////////////////////////////////////////////////////////////////////
+
+	void DeliveryModeTest::initialize()
+	{
+		switch ( Mode )
+		{
+		case EMode::ReliableOrdered:		Name = "ReliableOrderedTest"; break;
+		case EMode::ReliableUnordered:		Name = "ReliableUnorderedTest"; break;
+		case EMode::ReliableSubStream:		Name = "ReliableSubStreamTest"; break;
+		case EMode::Unreliable:				Name = "UnreliableUnsequencedTest"; break;
+		case EMode::UnreliableFec:			Name = "UnreliableFecTest"; break;
+		case EMode::UnreliableRedundant:	Name = "UnreliableRedundantTest"; break;
+		case EMode::LowLatency:				Name = "LowLatencyTest"; break;
+		case EMode::NewReno:				Name = "NewRenoTest"; break;
+		case EMode::DelayBased:				Name = "DelayBasedTest"; break;
+		case EMode::NoCoalescing:			Name = "NoCoalescingTest"; break;
+		case EMode::NoCompactHeader:		Name = "NoCompactHeaderTest"; break;
+		}
+	}
+
+	void DeliveryModeTest::run()
+	{
+		static const int nch = 8;
+		int nKeys = (Mode == EMode::ReliableSubStream ? 32 : nch); // sub-streams share the channels
+		bool bReliable = Mode != EMode::Unreliable && Mode != EMode::UnreliableFec && Mode != EMode::UnreliableRedundant;
+		// sequenced skips lost ones but never goes back, also not for a message that fec rebuilt after newer ones of its group arrived
+		bool bOrdered  = Mode != EMode::ReliableUnordered && Mode != EMode::Unreliable;
+		// fec does not protect fragmented messages and redundant ones must fit in a single datagram
+		int maxLen = (Mode == EMode::UnreliableRedundant ? 200 : Mode == EMode::UnreliableFec ? 1000 : 2500);
+
+		ZNode* g1 = new ZNode( 33, 8, -1);
+		ZNode* g2 = new ZNode( 33, 8, -1);
+
+		// these only apply to connections that are made afterwards
+		switch ( Mode )
+		{
+		case EMode::UnreliableFec:
+			for ( int i=0; i<nch; i++ ) g1->setUnreliableFec( (u8_t)i, 4 );
+			break;
+		case EMode::UnreliableRedundant:
+			for ( int i=0; i<nch; i++ ) g1->setUnreliableRedundancy( (u8_t)i, 3 );
+			break;
+		case EMode::LowLatency:
+			g1->setLowLatency( true );
+			g2->setLowLatency( true );
+			break;
+		case EMode::NewReno:
+			g1->setCongestionControl( ECongestionControl::NewReno );
+			break;
+		case EMode::DelayBased:
+			g1->setCongestionControl( ECongestionControl::DelayBased );
+			break;
+		case EMode::NoCoalescing:
+			g1->setCoalesceDelay( 0 );
+			g2->setCoalesceDelay( 0 );
+			break;
+		case EMode::NoCompactHeader:
+			// compact headers are only negotiated if the 16 bit sequence can address the window
+			g1->setReliableWindowSize( 1<<16 );
+			g2->setReliableWindowSize( 1<<16 );
+			break;
+		default:
+			break;
+		}
+
+		if ( !ConnectTestNodes( this, g2, { g1 }, 27100 + (int)Mode ) )
+		{
+			CloseTestNodes( { g1, g2 } );
+			return;
+		}
+
+		// loss only applies to open connections
+		g1->simulatePacketLoss( PackLoss );
+		g2->simulatePacketLoss( PackLoss );
+
+		int numRecv = 0;
+		std::vector<int> expSeq( nKeys, 0 );
+		std::vector<std::vector<bool>> recvSeq( nKeys, std::vector<bool>( NumSends, false ) );
+		g2->bindOnCustomData( [&] (auto& etp, auto id, auto* data, int len, unsigned char channel)
+		{
+			if ( id != 100 )
+				return;
+			int seq, key;
+			if ( !ReadTestMessage( data, len, seq, key ) || key < 0 || key >= nKeys || key % nch != channel || seq < 0 || seq >= NumSends )
+			{
+				printf( "%s corrupted message, len %d, channel %d\n", Name.c_str(), len, channel );
+				Result = false;
+				return;
+			}
+			if ( recvSeq[key][seq] )
+			{
+				printf( "%s duplicate -> seq %d, key %d\n", Name.c_str(), seq, key );
+				Result = false;
+				return;
+			}
+			recvSeq[key][seq] = true;
+			if ( bOrdered )
+			{
+				if ( seq < expSeq[key] || (bReliable && seq != expSeq[key]) )
+				{
+					printf( "%s unsequenced -> expected %d, found %d, key %d\n", Name.c_str(), expSeq[key], seq, key );
+					Result = false;
+				}
+				expSeq[key] = seq+1;
+			}
+			numRecv++;
+		});
+
+		int numTotal = nKeys * NumSends;
+		int numSent  = 0;
+		std::vector<int> sendSeq( nKeys, 0 );
+		std::vector<char> data( maxLen );
+		auto tStart = std::chrono::steady_clock::now();
+		auto tSendDone = tStart;
+		while ( Result && numRecv != numTotal )
+		{
+			// a few per tick, so that small messages get coalesced
+			for ( int i=0; i<8 && numSent<numTotal; i++ )
+			{
+				int key;
+				do key = ::rand() % nKeys; while ( sendSeq[key] == NumSends );
+				int len = TestMsgHdrSize + ::rand() % (maxLen - TestMsgHdrSize + 1);
+				WriteTestMessage( data.data(), len, sendSeq[key]++, key );
+				u8_t channel = (u8_t)(key % nch);
+				ESendCallResult sendResult;
+				switch ( Mode )
+				{
+				case EMode::ReliableUnordered:
+					sendResult = g1->sendReliableUnordered( 100, data.data(), len, nullptr, false, channel );
+					break;
+				case EMode::ReliableSubStream:
+					sendResult = g1->sendReliableSubStream( 100, data.data(), len, (u32_t)key, nullptr, false, channel );
+					break;
+				case EMode::Unreliable:
+					sendResult = g1->sendUnreliable( 100, data.data(), len, nullptr, false, channel );
+					break;
+				case EMode::UnreliableFec:
+					sendResult = g1->sendUnreliableSequenced( 100, data.data(), len, nullptr, false, channel );
+					break;
+				case EMode::UnreliableRedundant:
+					sendResult = g1->sendUnreliableRedundant( 100, data.data(), len, nullptr, false, channel );
+					break;
+				default:
+					sendResult = g1->sendReliableOrdered( 100, data.data(), len, nullptr, false, channel );
+					break;
+				}
+				if ( sendResult != ESendCallResult::Succes )
+				{
+					printf( "%s send failed with %d\n", Name.c_str(), (int)sendResult );
+					Result = false;
+				}
+				if ( ++numSent == numTotal )
+					tSendDone = std::chrono::steady_clock::now();
+			}
+			g1->update();
+			g2->update();
+			std::this_thread::sleep_for(5ms);
+			auto tNow = std::chrono::steady_clock::now();
+			// unreliable data that got through has arrived by then
+			if ( !bReliable && numSent == numTotal && tNow - tSendDone > 1000ms )
+				break;
+			if ( tNow - tStart > 30s )
+			{
+				printf( "%s timed out, received %d of %d\n", Name.c_str(), numRecv, numTotal );
+				Result = false;
+			}
+		}
+		printf( "%s received %d of %d\n", Name.c_str(), numRecv, numTotal );
+
+		if ( Result && !bReliable && numRecv == 0 )
+		{
+			printf( "%s received nothing\n", Name.c_str() );
+			Result = false;
+		}
+		// a message is only lost if the datagrams of all messages that repeat it are lost
+		if ( Result && Mode == EMode::UnreliableRedundant && numRecv < numTotal*9/10 )
+		{
+			printf( "%s lost too many, redundancy did not recover them\n", Name.c_str() );
+			Result = false;
+		}
+		// round trip time is measured from acks of data that was not retransmitted
+		if ( Result && bReliable )
+		{
+			i32_t latency = g1->getLatency( g1->getFirstEndpoint() );
+			i32_t variance = g1->getLatencyVariance( g1->getFirstEndpoint() );
+			if ( latency < 0 || latency > 1000 || variance < 0 )
+			{
+				printf( "%s invalid round trip time %d, variance %d\n", Name.c_str(), latency, variance );
+				Result = false;
+			}
+		}
+
+		CloseTestNodes( { g1, g2 } );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Fec Recovery Test
+	//////////////////////////////////////////////////////////////////////////
+
+	void FecRecoveryTest::initialize()
+	{
+		Name = "FecRecoveryTest";
+	}
+
+	void FecRecoveryTest::run()
+	{
+		ZNode* g1 = new ZNode( 33, 8, -1);
+		ZNode* g2 = new ZNode( 33, 8, -1);
+		g1->setUnreliableFec( 0, GroupSize );
+
+		if ( !ConnectTestNodes( this, g2, { g1 }, 27150 ) )
+		{
+			CloseTestNodes( { g1, g2 } );
+			return;
+		}
+
+		std::vector<int> recvSeqs;
+		g2->bindOnCustomData( [&] (auto& etp, auto id, auto* data, int len, unsigned char channel)
+		{
+			int seq, key;
+			if ( id != 100 || !ReadTestMessage( data, len, seq, key ) )
+			{
+				printf( "%s corrupted message, len %d\n", Name.c_str(), len );
+				Result = false;
+				return;
+			}
+			recvSeqs.emplace_back( seq );
+		});
+
+		// each message goes out in its own datagram, so that a single one can be lost
+		std::vector<char> data( 3000 );
+		int numSent = 0;
+		auto sendMessage = [&] (int len, bool bLose)
+		{
+			if ( bLose ) g2->simulatePacketLoss( 100 );
+			WriteTestMessage( data.data(), len, numSent++, 0 );
+			g1->sendUnreliableSequenced( 100, data.data(), len );
+			for ( int kTicks=0; kTicks<10; kTicks++ )
+			{
+				g1->update();
+				g2->update();
+				std::this_thread::sleep_for(5ms);
+			}
+			if ( bLose ) g2->simulatePacketLoss( 0 );
+		};
+
+		// first parity only tells the receiver to keep packets for recovery
+		for ( int i=0; i<GroupSize; i++ )
+			sendMessage( 100, false );
+		// second message lost, the parity that rebuilds it arrives after newer messages were delivered, so it is dropped
+		int droppedSeq = numSent + 1;
+		for ( int i=0; i<GroupSize; i++ )
+			sendMessage( 100, i == 1 );
+		// second message lost, a fragmented message ends the group early, so that nothing newer was delivered when it is rebuilt
+		sendMessage( 100, false );
+		sendMessage( 100, true );
+		sendMessage( (int)data.size(), false );
+
+		std::vector<int> expSeqs;
+		for ( int i=0; i<numSent; i++ )
+			if ( i != droppedSeq ) expSeqs.emplace_back( i );
+		if ( recvSeqs != expSeqs )
+		{
+			printf( "%s received:", Name.c_str() );
+			for ( auto seq : recvSeqs ) printf( " %d", seq );
+			printf( "\n" );
+			Result = false;
+		}
+
+		CloseTestNodes( { g1, g2 } );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Broadcast Test
+	//////////////////////////////////////////////////////////////////////////
+
+	void BroadcastTest::initialize()
+	{
+		Name = "BroadcastTest";
+	}
+
+	void BroadcastTest::run()
+	{
+		static const int nch = 8;
+		ZNode* server = new ZNode( 33, 8, -1);
+		std::vector<ZNode*> clients;
+		for ( int i=0; i<NumClients; i++ )
+			clients.emplace_back( new ZNode( 33, 8, -1) );
+		std::vector<ZNode*> nodes = clients;
+		nodes.emplace_back( server );
+
+		if ( !ConnectTestNodes( this, server, clients, 27200 ) )
+		{
+			CloseTestNodes( nodes );
+			return;
+		}
+
+		for ( auto* n : nodes )
+			n->simulatePacketLoss( PackLoss );
+
+		// the payload is shared by the connections, each client must get it intact and in order
+		std::vector<std::vector<int>> expSeq( NumClients, std::vector<int>( nch, 0 ) );
+		std::vector<int> numRecv( NumClients, 0 );
+		for ( int c=0; c<NumClients; c++ )
+		{
+			clients[c]->bindOnCustomData( [&, c] (auto& etp, auto id, auto* data, int len, unsigned char channel)
+			{
+				if ( id != 100 )
+					return;
+				int seq, key;
+				if ( !ReadTestMessage( data, len, seq, key ) || key != channel || seq != expSeq[c][channel] )
+				{
+					printf( "%s client %d corrupted or unsequenced message, len %d, channel %d\n", Name.c_str(), c, len, channel );
+					Result = false;
+					return;
+				}
+				expSeq[c][channel]++;
+				numRecv[c]++;
+			});
+		}
+
+		int numTotal = nch * NumSends;
+		int numSent  = 0;
+		std::vector<int> sendSeq( nch, 0 );
+		std::vector<char> data( 2500 );
+		auto tStart = std::chrono::steady_clock::now();
+		while ( Result )
+		{
+			for ( int i=0; i<8 && numSent<numTotal; i++, numSent++ )
+			{
+				int channel;
+				do channel = ::rand() % nch; while ( sendSeq[channel] == NumSends );
+				int len = TestMsgHdrSize + ::rand() % (int)(data.size() - TestMsgHdrSize + 1);
+				WriteTestMessage( data.data(), len, sendSeq[channel]++, channel );
+				if ( server->sendReliableOrdered( 100, data.data(), len, nullptr, false, (u8_t)channel ) != ESendCallResult::Succes )
+				{
+					printf( "%s send failed\n", Name.c_str() );
+					Result = false;
+				}
+			}
+			for ( auto* n : nodes )
+				n->update();
+			std::this_thread::sleep_for(5ms);
+			bool bDone = true;
+			for ( int c=0; c<NumClients; c++ )
+				bDone = bDone && numRecv[c] == numTotal;
+			if ( bDone )
+				break;
+			if ( std::chrono::steady_clock::now() - tStart > 30s )
+			{
+				printf( "%s timed out\n", Name.c_str() );
+				Result = false;
+			}
+		}
+
+		CloseTestNodes( nodes );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Relay Test
+	//////////////////////////////////////////////////////////////////////////
+
+	void RelayTest::initialize()
+	{
+		Name = "RelayTest";
+	}
+
+	void RelayTest::run()
+	{
+		static const int nch = 8;
+		ZNode* server = new ZNode( 33, 8, -1);
+		ZNode* a = new ZNode( 33, 8, -1);
+		ZNode* b = new ZNode( 33, 8, -1);
+
+		if ( !ConnectTestNodes( this, server, { a, b }, 27300 ) )
+		{
+			CloseTestNodes( { a, b, server } );
+			return;
+		}
+
+		server->simulatePacketLoss( PackLoss );
+		b->simulatePacketLoss( PackLoss );
+
+		std::vector<int> expSeq( nch, 0 );
+		int numRecv = 0;
+		b->bindOnCustomData( [&] (auto& etp, auto id, auto* data, int len, unsigned char channel)
+		{
+			if ( id != 100 )
+				return;
+			int seq, key;
+			if ( !ReadTestMessage( data, len, seq, key ) || key != channel || seq != expSeq[channel] )
+			{
+				printf( "%s corrupted or unsequenced message, len %d, channel %d\n", Name.c_str(), len, channel );
+				Result = false;
+				return;
+			}
+			expSeq[channel]++;
+			numRecv++;
+		});
+		a->bindOnCustomData( [&] (auto& etp, auto id, auto* data, int len, unsigned char channel)
+		{
+			if ( id == 100 )
+			{
+				printf( "%s message was relayed back to its sender\n", Name.c_str() );
+				Result = false;
+			}
+		});
+
+		// the server does not update, so everything b gets was relayed by the receive thread of the server
+		int numTotal = nch * NumSends;
+		std::vector<char> data( 1000 );
+		for ( int i=0; i<numTotal; i++ )
+		{
+			int channel = i % nch;
+			int len = TestMsgHdrSize + ::rand() % (int)(data.size() - TestMsgHdrSize + 1);
+			WriteTestMessage( data.data(), len, i / nch, channel );
+			a->sendReliableOrdered( 100, data.data(), len, nullptr, false, (u8_t)channel, true );
+		}
+		auto tStart = std::chrono::steady_clock::now();
+		while ( Result && numRecv != numTotal )
+		{
+			a->update();
+			b->update();
+			std::this_thread::sleep_for(5ms);
+			if ( std::chrono::steady_clock::now() - tStart > 10s )
+			{
+				printf( "%s timed out, received %d of %d\n", Name.c_str(), numRecv, numTotal );
+				Result = false;
+			}
+		}
+
+		CloseTestNodes( { a, b, server } );
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Send Budget Test
+	//////////////////////////////////////////////////////////////////////////
+
+	void SendBudgetTest::initialize()
+	{
+		Name = "SendBudgetTest";
+	}
+
+	void SendBudgetTest::run()
+	{
+		ZNode* server = new ZNode( 33, 8, -1);
+		ZNode* client = new ZNode( 33, 8, -1);
+		server->setSendQueueBudget( MaxBytes, 0 );
+		server->setChannelSendQueueBudget( 1, 0, MaxChannelMessages );
+
+		if ( !ConnectTestNodes( this, server, { client }, 27400 ) )
+		{
+			CloseTestNodes( { client, server } );
+			return;
+		}
+
+		ZEndpoint etp = server->getFirstEndpoint();
+		int numRecv = 0;
+		int expSeq[2] = { 0, 0 };
+		client->bindOnCustomData( [&] (auto& etp, auto id, auto* data, int len, unsigned char channel)
+		{
+			int seq, key;
+			if ( id != 100 || channel > 1 || !ReadTestMessage( data, len, seq, key ) || key != channel || seq != expSeq[channel] )
+			{
+				printf( "%s corrupted or unsequenced message, len %d, channel %d\n", Name.c_str(), len, channel );
+				Result = false;
+				return;
+			}
+			expSeq[channel]++;
+			numRecv++;
+		});
+
+		// client drops everything, so nothing gets acked and the queues fill up
+		client->simulatePacketLoss( 100 );
+
+		const int msgLen = 1000;
+		char data[msgLen];
+		int numAccepted[2] = { 0, 0 };
+		int numBlocked[2] = { 0, 0 };
+		auto sendUntilBlocked = [&] (int channel, int len, int maxSends)
+		{
+			for ( int i=0; i<maxSends; i++ )
+			{
+				WriteTestMessage( data, len, numAccepted[channel], channel );
+				ESendCallResult sendResult = server->sendReliableOrdered( 100, data, len, nullptr, false, (u8_t)channel );
+				if ( sendResult == ESendCallResult::Succes ) numAccepted[channel]++;
+				else if ( sendResult == ESendCallResult::WouldBlock ) numBlocked[channel]++;
+				else Result = false;
+			}
+		};
+		// channel budget first, otherwise the connection budget is full before it
+		sendUntilBlocked( 1, 16, MaxChannelMessages*2 );
+		sendUntilBlocked( 0, msgLen, 2*MaxBytes/msgLen );
+		i32_t queuedBytes = server->getQueuedSendBytes( etp );
+		i32_t queuedMessages = server->getQueuedSendMessages( etp );
+		printf( "%s accepted %d and %d, queued %d bytes in %d messages\n", Name.c_str(), numAccepted[0], numAccepted[1], queuedBytes, queuedMessages );
+		if ( numAccepted[1] != MaxChannelMessages || numBlocked[1] != MaxChannelMessages || server->getQueuedSendMessages( etp, 1 ) != MaxChannelMessages )
+		{
+			printf( "%s channel budget not applied\n", Name.c_str() );
+			Result = false;
+		}
+		if ( numAccepted[0] == 0 || numBlocked[0] == 0 || numAccepted[0]*msgLen > MaxBytes ||
+			 queuedMessages != numAccepted[0] + numAccepted[1] || queuedBytes < numAccepted[0]*msgLen )
+		{
+			printf( "%s connection budget not applied\n", Name.c_str() );
+			Result = false;
+		}
+
+		// once acked the queues drain and everything that was accepted arrives
+		client->simulatePacketLoss( 0 );
+		auto tStart = std::chrono::steady_clock::now();
+		while ( Result && (numRecv != numAccepted[0] + numAccepted[1] || server->getQueuedSendMessages( etp ) != 0 || server->getQueuedSendBytes( etp ) != 0) )
+		{
+			server->update();
+			client->update();
+			std::this_thread::sleep_for(5ms);
+			if ( std::chrono::steady_clock::now() - tStart > 10s )
+			{
+				printf( "%s timed out, received %d, queued %d bytes\n", Name.c_str(), numRecv, server->getQueuedSendBytes( etp ) );
+				Result = false;
+			}
+		}
+		WriteTestMessage( data, msgLen, numAccepted[0], 0 );
+		if ( Result && server->sendReliableOrdered( 100, data, msgLen ) != ESendCallResult::Succes )
+		{
+			printf( "%s still blocked after the queues drained\n", Name.c_str() );
+			Result = false;
+		}
+
+		CloseTestNodes( { client, server } );
+	}
+
+
 	//////////////////////////////////////////////////////////////////////////
 	/// RPC
 	//////////////////////////////////////////////////////////////////////////
@@ -1142,6 +1755,12 @@ namespace UnitTests
 	//	tests.emplace_back( new MassConnectTest );
 	//	tests.emplace_back( new ReliableOrderTest(false) );
 		tests.emplace_back( new ReliableOrderTest(true) );
+		for ( int i=0; i<=(int)DeliveryModeTest::EMode::NoCompactHeader; i++ )
+			tests.emplace_back( new DeliveryModeTest( (DeliveryModeTest::EMode)i ) );
+		tests.emplace_back( new FecRecoveryTest );
+		tests.emplace_back( new BroadcastTest );
+		tests.emplace_back( new RelayTest );
+		tests.emplace_back( new SendBudgetTest );
 	//	tests.emplace_back( new RpcTest );
 	//	tests.emplace_back( new SyncGroupTest );
 			
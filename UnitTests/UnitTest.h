@@ -77,6 +77,73 @@ namespace UnitTests
 		virtual void run() override;
 	};
 
+	struct DeliveryModeTest: public BaseTest
+	{
+		enum class EMode
+		{
+			ReliableOrdered,	// compact headers, coalescing and selective acks are on by default
+			ReliableUnordered,
+			ReliableSubStream,
+			Unreliable,
+			UnreliableFec,
+			UnreliableRedundant,
+			LowLatency,
+			NewReno,
+			DelayBased,
+			NoCoalescing,
+			NoCompactHeader
+		};
+
+		EMode Mode;
+		int NumSends; // per channel or sub-stream
+		int PackLoss; // %, on both nodes so that acks get lost as well
+		// congestion control takes loss for congestion, under heavy random loss it keeps a single packet in flight
+		DeliveryModeTest(EMode mode) : Mode(mode), NumSends(50), PackLoss(mode == EMode::NewReno || mode == EMode::DelayBased ? 5 : 25) { }
+
+		virtual void initialize() override;
+		virtual void run() override;
+	};
+
+	struct FecRecoveryTest: public BaseTest
+	{
+		int GroupSize;
+		FecRecoveryTest() : GroupSize(4) { }
+
+		virtual void initialize() override;
+		virtual void run() override;
+	};
+
+	struct BroadcastTest: public BaseTest
+	{
+		int NumClients;
+		int NumSends; // per channel
+		int PackLoss; // %
+		BroadcastTest() : NumClients(3), NumSends(50), PackLoss(10) { }
+
+		virtual void initialize() override;
+		virtual void run() override;
+	};
+
+	struct RelayTest: public BaseTest
+	{
+		int NumSends; // per channel, must fit in the receive queue of the server as it does not update
+		int PackLoss; // %
+		RelayTest() : NumSends(20), PackLoss(10) { }
+
+		virtual void initialize() override;
+		virtual void run() override;
+	};
+
+	struct SendBudgetTest: public BaseTest
+	{
+		int MaxBytes;
+		int MaxChannelMessages;
+		SendBudgetTest() : MaxBytes(64*1024), MaxChannelMessages(10) { }
+
+		virtual void initialize() override;
+		virtual void run() override;
+	};
+
 	struct RpcTest: public BaseTest
 	{
 		virtual void initialize() override;